@@ -39,9 +39,238 @@
 #define FDS_FIRSTFLASHPAGE              (BSP_FLASH_NUMPAGES - FDS_NUM_PAGES)
 
 /**
- * @brief Defines the magic used in page header.
+ * @brief Defines the page number of the first flash page used for slot arrays.
  */
-#define FDS_PAGEMAGIC                   (0xAA)
+#define FDS_FIRSTSLOTPAGE               (FDS_FIRSTFLASHPAGE - FDS_NUM_SLOTPAGES)
+
+/**
+ * @brief Defines the page number of the first flash page used for pinned 
+ * records, each of them uses two pages.
+ */
+#define FDS_FIRSTPINPAGE                (FDS_FIRSTSLOTPAGE - FDS_NUM_PINNED * 2)
+
+/**
+ * @brief Defines the total number of flash pages used by libfds.
+ */
+#define FDS_NUM_ALLPAGES                (FDS_NUM_PINNED * 2 +                  \
+                                        FDS_NUM_SLOTPAGES + FDS_NUM_PAGES)
+
+/**
+ * @brief Defines the size of a flash page in bytes.
+ */
+#define FDS_PAGESIZE                    ((size_t)(                             \
+                                        (uint8_t*)BSP_FLASH_PAGETOADDR(1) -    \
+                                        (uint8_t*)BSP_FLASH_PAGETOADDR(0)))
+
+/**
+ * @brief Used to round up the given value to a multiple of align, which must 
+ * be a power of two.
+ */
+#define FDS_ALIGNUP(val, align)         (((val) + (align) - 1) &               \
+                                        ~((size_t)(align) - 1))
+
+/**
+ * @brief Defines the number of padding bytes needed in front of a data header
+ * at the given address, so the data following the header is aligned to 
+ * FDS_PAYLOAD_ALIGN.
+ */
+#define FDS_PADDING(addr)               ((FDS_PAYLOAD_ALIGN - (((uintptr_t)    \
+                                        (addr) + sizeof(fdsDataHdr_t)) &       \
+                                        (FDS_PAYLOAD_ALIGN - 1))) &            \
+                                        (FDS_PAYLOAD_ALIGN - 1))
+
+/**
+ * @brief Defines the offset of the first slot in a slot array page using the 
+ * given payload alignment.
+ */
+#define FDS_SLOTOFFSET(align)           FDS_ALIGNUP(sizeof(fdsPageHdr_t), align)
+
+/**
+ * @brief Defines the size of a single slot of a slot array in bytes for the 
+ * given payload alignment.
+ */
+#define FDS_SLOTSIZE(siz, align)        FDS_ALIGNUP((((siz) + 1) & ~1) +       \
+                                        sizeof(fdsSlotFtr_t), align)
+
+/**
+ * @brief Defines the number of slots per flash page of a slot array.
+ */
+#define FDS_SLOTSPERPAGE(siz, align)    ((FDS_PAGESIZE -                       \
+                                        FDS_SLOTOFFSET(align)) /               \
+                                        FDS_SLOTSIZE(siz, align))
+
+/**
+ * @brief Defines the size of a single copy in the home location of a record if
+ * FDS_BYTEWRITE is set.
+ */
+#define FDS_HOMESIZE                    FDS_ALIGNUP(                           \
+                                        FDS_RECORDSIZE(FDS_MAX_DATABYTES),     \
+                                        FDS_PAYLOAD_ALIGN)
+
+/**
+ * @brief Defines the size of a data record in the flash in bytes for the given
+ * number of user data bytes.
+ */
+#define FDS_RECORDSIZE(siz)             (sizeof(fdsDataHdr_t) + ((siz) & ~1) + \
+                                        sizeof(fdsDataFtr_t))
+
+/**
+ * @brief Defines the magic used in the page header of pages written before the
+ * on flash format has been versioned. Such pages are still read but never 
+ * written again.
+ */
+#define FDS_PAGEMAGIC_V0                (0xAA)
+
+/**
+ * @brief Defines the magic used in the page header of versioned pages. The 
+ * lower nibble holds the format flags of the page.
+ */
+#define FDS_PAGEMAGIC_V1                (0xC0)
+
+/**
+ * @brief Defines the bits of the page magic used for the format flags.
+ */
+#define FDS_PAGEFMT_MASK                (0x0F)
+
+/**
+ * @brief Format flag of pages which may contain bundle records.
+ */
+#define FDS_PAGEFMT_BUNDLE              (0x01)
+
+/**
+ * @brief Format flag of pages whose records end with a commit marker instead 
+ * of a CRC, see FDS_INTEGRITY_ECC.
+ */
+#define FDS_PAGEFMT_ECC                 (0x02)
+
+/**
+ * @brief Defines the bits of the format flags holding the payload alignment of
+ * the page, 0 to 3 for 2 to 16 bytes. Records are padded with zero half words 
+ * on pages using a alignment above 2 bytes, see FDS_PAYLOAD_ALIGN.
+ */
+#define FDS_PAGEFMT_ALIGNMASK           (0x0C)
+
+/**
+ * @brief Defines the format flags known by this version of libfds. Pages using
+ * other flags have been written by a newer version and can not be read.
+ */
+#define FDS_PAGEFMT_KNOWN               (FDS_PAGEFMT_BUNDLE | FDS_PAGEFMT_ECC |\
+                                        FDS_PAGEFMT_ALIGNMASK)
+
+/**
+ * @brief Defines the alignment bits of the format flags used for new pages.
+ */
+#if FDS_PAYLOAD_ALIGN == 16
+#define FDS_PAGEFMT_ALIGN               (0x0C)
+#elif FDS_PAYLOAD_ALIGN == 8
+#define FDS_PAGEFMT_ALIGN               (0x08)
+#elif FDS_PAYLOAD_ALIGN == 4
+#define FDS_PAGEFMT_ALIGN               (0x04)
+#else
+#define FDS_PAGEFMT_ALIGN               (0x00)
+#endif
+
+/**
+ * @brief Defines the format flags used for new pages.
+ */
+#if FDS_INTEGRITY_ECC
+#define FDS_PAGEFMT                     (FDS_PAGEFMT_BUNDLE | FDS_PAGEFMT_ECC |\
+                                        FDS_PAGEFMT_ALIGN)
+#else
+#define FDS_PAGEFMT                     (FDS_PAGEFMT_BUNDLE | FDS_PAGEFMT_ALIGN)
+#endif
+
+/**
+ * @brief Defines the magic used in the header of new pages.
+ */
+#define FDS_PAGEMAGIC                   (FDS_PAGEMAGIC_V1 | FDS_PAGEFMT)
+
+/**
+ * @brief Defines the size in bytes of the words programmed on new pages, see 
+ * FDS_ECC_WORDSIZE.
+ */
+#if FDS_INTEGRITY_ECC
+#define FDS_WORDSIZE                    FDS_ECC_WORDSIZE
+#else
+#define FDS_WORDSIZE                    2
+#endif
+
+/**
+ * @brief Defines the size of the page header of new pages, it is padded with 
+ * zeros to a full word.
+ */
+#define FDS_PAGEHDRSIZE                 FDS_ALIGNUP(sizeof(fdsPageHdr_t),      \
+                                        FDS_WORDSIZE)
+
+/**
+ * @brief Defines the alignment of the slots and pinned records on new pages.
+ */
+#define FDS_SLOTALIGN                   (FDS_PAYLOAD_ALIGN > FDS_WORDSIZE ?    \
+                                        FDS_PAYLOAD_ALIGN : FDS_WORDSIZE)
+
+/**
+ * @brief Used to check if a page magic is known by this version of libfds.
+ */
+#define FDS_PAGEMAGIC_ISKNOWN(magic)    (((magic) == FDS_PAGEMAGIC_V0) ||      \
+                                        ((((magic) & ~FDS_PAGEFMT_MASK) ==     \
+                                        FDS_PAGEMAGIC_V1) && (((magic) &       \
+                                        ~FDS_PAGEFMT_KNOWN &                   \
+                                        FDS_PAGEFMT_MASK) == 0)))
+
+/**
+ * @brief Used to check if a page magic has the given format flag set.
+ */
+#define FDS_PAGEMAGIC_HASFMT(magic, fmt) ((((magic) & ~FDS_PAGEFMT_MASK) ==    \
+                                        FDS_PAGEMAGIC_V1) && ((magic) & (fmt)))
+
+/**
+ * @brief Used to get the payload alignment in bytes of a page from its magic.
+ */
+#define FDS_PAGEMAGIC_ALIGN(magic)      (2 << ((((magic) & ~FDS_PAGEFMT_MASK)  \
+                                        == FDS_PAGEMAGIC_V1) ? (((magic) &     \
+                                        FDS_PAGEFMT_ALIGNMASK) >> 2) : 0))
+
+/**
+ * @brief Used to get the size in bytes of the words programmed on a page from
+ * its magic. Pages using FDS_PAGEFMT_ECC are written in words of 
+ * FDS_ECC_WORDSIZE bytes, all others in half words.
+ */
+#define FDS_PAGEMAGIC_WORD(magic)       (FDS_PAGEMAGIC_HASFMT(magic,           \
+                                        FDS_PAGEFMT_ECC) ? FDS_ECC_WORDSIZE : 2)
+
+/**
+ * @brief Used to get the alignment of the slots on a page from its magic. Each
+ * slot covers full words.
+ */
+#define FDS_PAGEMAGIC_SLOTALIGN(magic)  (FDS_PAGEMAGIC_ALIGN(magic) >          \
+                                        FDS_PAGEMAGIC_WORD(magic) ?            \
+                                        FDS_PAGEMAGIC_ALIGN(magic) :           \
+                                        FDS_PAGEMAGIC_WORD(magic))
+
+/**
+ * @brief Defines the address following a record with the given number of user
+ * data bytes starting at the given address, on a page using the given word 
+ * size. On pages using words above two bytes the data is padded to full words
+ * and the footer ends a word of its own, otherwise this equals 
+ * FDS_RECORDSIZE().
+ */
+#define FDS_RECORDEND(addr, siz, word)  (FDS_ALIGNUP((uintptr_t)(addr) +       \
+                                        sizeof(fdsDataHdr_t) + (((siz) +       \
+                                        ((word) > 2)) & ~1), word) +           \
+                                        FDS_ALIGNUP(sizeof(fdsDataFtr_t), word))
+
+/**
+ * @brief Defines the value used instead of the CRC in the footer of records 
+ * on pages using FDS_PAGEFMT_ECC. It is written at last and therefore marks 
+ * the record as complete.
+ */
+#define FDS_COMMITMAGIC                 (0xC3)
+
+/**
+ * @brief Set if records written by this version of libfds are protected by a 
+ * software CRC.
+ */
+#define FDS_USE_CRC                     ((FDS_PAGEFMT & FDS_PAGEFMT_ECC) == 0)
 
 /**
  * @brief Defines the magic used in the header for data records.
@@ -53,13 +282,56 @@
  */
 #define FDS_DELMAGIC                    (0x7E)
 
+/**
+ * @brief Defines the magic used in the header of bundle records.
+ */
+#define FDS_BUNDLEMAGIC                 (0x5A)
+
+/**
+ * @brief Defines the magic used in the header of entries within a bundle.
+ */
+#define FDS_ENTRYMAGIC                  (0xA5)
+
+/**
+ * @brief Used to measure the cycles of a operation if FDS_CYCLES() is defined,
+ * see fdsStats_t. The delta of a single operation is taken in 32 bit, so a 
+ * wrap of the cycle counter does not matter, and added to the 64 bit sum.
+ */
+#if FDS_STATS_CYCLES
+#define FDS_CYCLES_START(var)           uint32_t var = FDS_CYCLES()
+#define FDS_CYCLES_ADD(cnt, var)        (Stats.cnt += (uint32_t)(FDS_CYCLES()  \
+                                        - (var)))
+#else
+#define FDS_CYCLES_START(var)
+#define FDS_CYCLES_ADD(cnt, var)
+#endif
+
 Fds* Fds::pInstance = 0;
 
+#if FDS_NUM_SLOTARRAYS > 0
+const Fds::fdsSlotCfg_t Fds::SlotCfg[FDS_NUM_SLOTARRAYS] = FDS_SLOTARRAYS;
+#endif
+
+#if FDS_NUM_PINNED > 0
+const Fds::fdsPinCfg_t Fds::PinCfg[FDS_NUM_PINNED] = FDS_PINNED;
+#endif
+
 Fds::Fds():
      InitDone(false),
-     pWrite(0)
+     pWrite(0),
+     pBurst(0)
 {
-
+#if FDS_STATS
+    resetStats();
+#endif
+
+#if FDS_SYNC
+    BatchDepth = 0;
+    SyncPending = false;
+#if FDS_BYTEWRITE
+    SyncUid = 0;
+#endif
+#endif
 }
 
 Fds::~Fds()
@@ -77,35 +349,119 @@ Fds* Fds::getInstance(void)
     return pInstance;
 }
 
-fdsStatus_t Fds::init(bool doReset)
+fdsStatus_t Fds::init(bool doReset, bool force)
 {
     fdsStatus_t retval = FDS_OK;
-    uint16_t pageId = 0;
-    uint16_t delta = 0;
-    bool updateWritePtr = true;
+    bool repaired = false;
+    bool failed = false;
+
+#if FDS_NUM_SLOTARRAYS > 0
+    uint16_t numPages = 0;
+
+    for (uint8_t idx = 0; idx < FDS_NUM_SLOTARRAYS; idx++)
+    {
+        if ((SlotCfg[idx].Uid >= FDS_NUM_RECORDS) || (SlotCfg[idx].Siz == 0) ||
+            (SlotCfg[idx].Siz > FDS_MAX_DATABYTES) || 
+            (SlotCfg[idx].NumPages < 2))
+        {
+            logErr("Invalid slot array %u\n", idx);
+            return FDS_EEINVAL;
+        }
+
+        numPages += SlotCfg[idx].NumPages;
+    }
+
+    if (numPages != FDS_NUM_SLOTPAGES)
+    {
+        logErr("Invalid number of slot pages %u\n", numPages);
+        return FDS_EEINVAL;
+    }
+#endif
+
+#if FDS_NUM_PINNED > 0
+    for (uint8_t idx = 0; idx < FDS_NUM_PINNED; idx++)
+    {
+        if ((PinCfg[idx].Uid >= FDS_NUM_RECORDS) || (PinCfg[idx].Siz == 0) ||
+            (PinCfg[idx].Siz > FDS_MAX_DATABYTES))
+        {
+            logErr("Invalid pinned record %u\n", idx);
+            return FDS_EEINVAL;
+        }
+    }
+#endif
+
+#if FDS_BYTEWRITE
+    if (sizeof(fdsPageHdr_t) + FDS_PAYLOAD_ALIGN + FDS_NUM_RECORDS * 
+        (sizeof(uint16_t) + 2 * FDS_HOMESIZE) > FDS_NUM_PAGES * FDS_PAGESIZE)
+    {
+        logErr("Records do not fit\n");
+        return FDS_EEINVAL;
+    }
+#endif
+
+    if (force == true)
+    {
+        InitDone = false;
+    }
 
     if (InitDone == false)
     {
+        FDS_CYCLES_START(cycles);
         memset(&pRecords, 0, sizeof(pRecords));
         pWrite = 0;
 
-        for (uint16_t page = 0; page < FDS_NUM_PAGES; page++)
+#if FDS_BYTEWRITE
+        retval = readHomes();
+        if(retval != FDS_OK)
+        {
+            logErr("Error %d while reading the home locations\n", retval);
+        }
+#else
+        uint16_t pageId = 0;
+        uint16_t prevId = 0;
+        uint16_t first = 0;
+
+        /* The oldest page is the one which does not follow its predecessor */
+        for (first = 0; first < FDS_NUM_PAGES; first++)
+        {
+            pageId = getPageid(first);
+            prevId = getPageid(
+                wrapInc(first, FDS_NUM_PAGES - 1, FDS_NUM_PAGES));
+
+            if ((pageId != 0xFFFF) && 
+                ((prevId == 0xFFFF) || (wrapInc(prevId, 1, 0xFFFF) != pageId)))
+            {
+                break;
+            }
+        }
+
+        /* Read all pages from the oldest to the most recent one, so newer
+         * records replace older ones and pWrite ends up in the last page.
+         * */
+        for (uint16_t n = 0; n < FDS_NUM_PAGES && first < FDS_NUM_PAGES; n++)
         {
+            uint16_t page = wrapInc(first, n, FDS_NUM_PAGES);
+
+            prevId = pageId;
             pageId = getPageid(page);
-            delta = getPageid(wrapInc(page, 1, FDS_NUM_PAGES)) - pageId;
 
             if (pageId == 0xFFFF)
             {
-                continue;
+                break;
             }
-            else if (delta > 0)
+            else if (!FDS_PAGEMAGIC_ISKNOWN(getPageMagic(page)))
             {
-                retval = readPage(page, updateWritePtr);
-                updateWritePtr = delta > 2 ? false : true;
+                logErr("Unknown format 0x%02x on page %u\n", 
+                    getPageMagic(page), page);
+                retval = FDS_EDATA;
+            }
+            else if ((n == 0) || (wrapInc(prevId, 1, 0xFFFF) == pageId))
+            {
+                retval = readPage(page, true);
             }
             else
             {
-                /* delta == 0 --> this is forbidden!! */
+                /* Gaps in the page numbering are forbidden!! */
                 retval = FDS_ERR;
             }
 
@@ -115,21 +471,72 @@ fdsStatus_t Fds::init(bool doReset)
                 break;
             }
         }
-    }
+#endif
 
-    if((retval != FDS_OK) || (pWrite == 0))
-    {
-        if(doReset == true)
+        /* Errors are solved by formatting the affected region only, so the 
+         * other regions keep their records.
+         * */
+        if ((retval != FDS_OK) || (pWrite == 0))
         {
-            logInfo("Erasing fds flash.\n");
-            retval = format();
+            if (doReset == true)
+            {
+                logInfo("Erasing fds log pages.\n");
+                retval = formatLog();
+                repaired = true;
+            }
+            else
+            {
+                logDebug("Erasing fds log pages supressed.\n");
+                failed = true;
+            }
         }
-        else
+
+#if FDS_NUM_SLOTARRAYS > 0
+        for (uint8_t idx = 0; (idx < FDS_NUM_SLOTARRAYS) && (retval == FDS_OK); 
+             idx++)
+        {
+            retval = readSlotArray(idx);
+            if(retval != FDS_OK)
+            {
+                logErr("Error %d while reading slot array %u\n", retval, idx);
+                if (doReset == true)
+                {
+                    logInfo("Erasing slot array %u.\n", idx);
+                    retval = formatSlotArray(idx);
+                    repaired = true;
+                }
+            }
+        }
+#endif
+
+        /* A pinned record is never erased here, a failed restore still leaves
+         * the backup copy for the next attempt.
+         * */
+#if FDS_NUM_PINNED > 0
+        for (uint8_t idx = 0; (idx < FDS_NUM_PINNED) && (retval == FDS_OK); 
+             idx++)
+        {
+            retval = readPinned(idx);
+            if(retval != FDS_OK)
+            {
+                logErr("Error %d while reading pinned record %u\n", retval, 
+                    idx);
+            }
+        }
+#endif
+
+#if FDS_STATS
+        Stats.Mounts++;
+        FDS_CYCLES_ADD(MountCycles, cycles);
+#endif
+
+        if ((retval == FDS_OK) && repaired)
         {
-            logDebug("Erasing fds flash supressed.\n");
+            return init(false);
         }
     }
-    else
+
+    if ((retval == FDS_OK) && !failed)
     {
         InitDone = true;
     }
@@ -157,6 +564,9 @@ fdsStatus_t Fds::info(void)
         FDS_FIRSTFLASHPAGE, (uint32_t)BSP_FLASH_PAGETOADDR(FDS_FIRSTFLASHPAGE));
     printf("  Num pages: %u\n", FDS_NUM_PAGES);
     printf("  Num supported id's: %u\n", FDS_NUM_RECORDS);
+    printf("  Num slot arrays: %u on %u pages\n", FDS_NUM_SLOTARRAYS, 
+        FDS_NUM_SLOTPAGES);
+    printf("  Num pinned records: %u\n", FDS_NUM_PINNED);
     printf("  pWrite on page %ld @ 0x%08lX\n", 
         BSP_FLASH_ADDRTOPAGE(pWrite) - FDS_FIRSTFLASHPAGE, (uint32_t)pWrite);
     
@@ -181,17 +591,61 @@ fdsStatus_t Fds::info(void)
         printf(".\n");
     }
 
+#if FDS_STATS
+    uint32_t minErases = 0xFFFFFFFF;
+    uint32_t maxErases = 0;
+
+    for (uint16_t page = 0; page < FDS_NUM_ALLPAGES; page++)
+    {
+        if (Stats.Erases[page] < minErases)
+        {
+            minErases = Stats.Erases[page];
+        }
+
+        if (Stats.Erases[page] > maxErases)
+        {
+            maxErases = Stats.Erases[page];
+        }
+    }
+
+    printf("  Writes: %llu, %llu user bytes, %llu flash bytes\n", 
+        (unsigned long long)Stats.Writes, (unsigned long long)Stats.UserBytes, 
+        (unsigned long long)Stats.FlashBytes);
+    printf("  Erases per page: min %lu max %lu\n", 
+        (unsigned long)minErases, (unsigned long)maxErases);
+    printf("  Reads: %llu, mounts: %lu, syncs: %llu\n", 
+        (unsigned long long)Stats.Reads, (unsigned long)Stats.Mounts, 
+        (unsigned long long)Stats.Syncs);
+#if FDS_STATS_CYCLES
+    printf("  Cycles: write %llu, read %llu, mount %llu\n", 
+        (unsigned long long)Stats.WriteCycles, 
+        (unsigned long long)Stats.ReadCycles, 
+        (unsigned long long)Stats.MountCycles);
+#endif
+#endif
+
     return retval;
 }
 
+#if FDS_STATS
+
+const fdsStats_t* Fds::getStats(void)
+{
+    return &Stats;
+}
+
+void Fds::resetStats(void)
+{
+    memset(&Stats, 0, sizeof(Stats));
+}
+
+#endif /* FDS_STATS */
+
 fdsStatus_t Fds::write(uint8_t uid, void* pData, size_t numBytes)
 {
     fdsStatus_t retval = FDS_OK;
-    uint16_t *pStart = pWrite;
-    size_t siz = 0;
-    fdsDataHdr_t hdr;
-    fdsDataFtr_t ftr;
-    crc8 crc;
+    fdsBundleEntry_t entry;
+    uint16_t *pStart = 0;
 
     if ((numBytes == 0) || (numBytes > FDS_MAX_DATABYTES))
     {
@@ -212,81 +666,71 @@ fdsStatus_t Fds::write(uint8_t uid, void* pData, size_t numBytes)
         }
     }
 
-    /* Prepare the data header. In the header the real number of user data bytes
-     * has to be used! The crc clauclation can also start right now as the 
-     * header is compleate.
-     * */
-    hdr.Magic = FDS_DATAMAGIC;
-    hdr.Uid = uid;
-    hdr.Siz = numBytes;
-    crc.calc(&hdr, sizeof(hdr));
+    FDS_CYCLES_START(cycles);
 
-    /* There is a spare byte reserved in the footer. It shall be used for user 
-     * data if the users data size is uneven. In this case the nuber of user 
-     * data bytes has to be reduced by one. 
-     * */
-    if(numBytes%2 != 0)
+#if FDS_NUM_SLOTARRAYS > 0
+    int16_t idx = getSlotArray(uid);
+    if (idx >= 0)
     {
-        numBytes--;
-        ftr.Data = ((uint8_t*)pData)[numBytes];
-    }
-    else
-    {
-        ftr.Data = 0;
+        if (numBytes != SlotCfg[idx].Siz)
+        {
+            return FDS_ESIZE;
+        }
+
+        retval = writeSlot(idx, FDS_DATAMAGIC, pData);
+        FDS_CYCLES_ADD(WriteCycles, cycles);
+        return retval;
     }
-    
-    /* Calculate the size of the record in the flash */
-    siz = (sizeof(hdr) + numBytes + sizeof(ftr)) / 2;
+#endif
 
-    /* If this does not fit in the current page proceed on the next page */
-    if (BSP_FLASH_ADDRTOPAGE(pWrite) != BSP_FLASH_ADDRTOPAGE(pWrite + siz))
+#if FDS_NUM_PINNED > 0
+    int16_t pin = getPinned(uid);
+    if (pin >= 0)
     {
-        retval = switchPage(uid);
-        if(retval != FDS_OK)
+        if (numBytes != PinCfg[pin].Siz)
         {
-            logErr("Error %u while switchPage\n", retval);
-            return retval;
+            return FDS_ESIZE;
         }
-    }
 
-    logDebug("New data starts @ 0x%08lx\n", (uint32_t)pWrite);
+        retval = writePinned(pin, FDS_DATAMAGIC, pData);
+        FDS_CYCLES_ADD(WriteCycles, cycles);
+        return retval;
+    }
+#endif
 
-    do
+    entry.Uid = uid;
+    entry.pData = pData;
+    entry.Siz = numBytes;
+    retval = prepareWrite(&entry, 1, numBytes);
+    if(retval != FDS_OK)
     {
-        retval = writeToFlash(&hdr, sizeof(hdr), false);
-        breakIfDiverse(retval, FDS_OK);
-    
-        if(numBytes > 0)
-        {
-            crc.calc(pData, numBytes);
-            retval = writeToFlash(pData, numBytes, false);
-            breakIfDiverse(retval, FDS_OK);
-        }
-        
-        /* The footer union takes care of correct byte postions. If a change is 
-         * needed read the doc of fdsDataFtr_t first.
-         * */
-        ftr.Crc = crc.calc(ftr.Data);
-        retval = writeToFlash(&ftr, sizeof(ftr), false);
-        breakIfDiverse(retval, FDS_OK);
-    
-    } while (0);
+        return retval;
+    }
 
+    pStart = pWrite;
+    retval = writeRecord(FDS_DATAMAGIC, uid, pData, numBytes);
     if (retval != FDS_OK)
     {
-        logErr("Error %u while writing to the flash\n", retval);
-        return FDS_EFLASH;
+        return retval;
     }
 
-    crc = 0;
-    if (crc.calc(pStart, siz * 2) != 0)
+#if FDS_BYTEWRITE
+    retval = commitHome(uid, pStart);
+    if (retval != FDS_OK)
     {
-        return FDS_ECRC;
+        return retval;
     }
+#endif
 
     pRecords[uid] = pStart;
 
-    return FDS_OK;
+#if FDS_STATS
+    Stats.Writes++;
+    Stats.UserBytes += numBytes;
+    FDS_CYCLES_ADD(WriteCycles, cycles);
+#endif
+
+    return commitWrite();
 }
 
 size_t Fds::read(uint8_t uid, void* pData, size_t siz)
@@ -314,21 +758,138 @@ size_t Fds::read(uint8_t uid, void* pData, size_t siz)
         return 0;
     }
 
-    pHdr = (fdsDataHdr_t*)pRecords[uid];
-    pFlash = (uint8_t*)(pRecords[uid]) + sizeof(fdsDataHdr_t);
+    FDS_CYCLES_START(cycles);
+
+#if FDS_STATS
+    Stats.Reads++;
+#endif
+
+#if FDS_NUM_SLOTARRAYS > 0
+    int16_t idx = getSlotArray(uid);
+    if (idx >= 0)
+    {
+        siz = min(siz, SlotCfg[idx].Siz);
+        memcpy(pData, pRecords[uid], siz);
+        FDS_CYCLES_ADD(ReadCycles, cycles);
+        return siz;
+    }
+#endif
+
+#if FDS_NUM_PINNED > 0
+    int16_t pin = getPinned(uid);
+    if (pin >= 0)
+    {
+        siz = min(siz, PinCfg[pin].Siz);
+        memcpy(pData, pRecords[uid], siz);
+        FDS_CYCLES_ADD(ReadCycles, cycles);
+        return siz;
+    }
+#endif
+
+    pHdr = (fdsDataHdr_t*)pRecords[uid];
+    pFlash = (uint8_t*)(pRecords[uid]) + sizeof(fdsDataHdr_t);
     siz = min(siz, pHdr->Siz);
+
+#if FDS_INTEGRITY_ECC
+    /* The data is not covered by a CRC, so errors reported by the flash while
+     * copying it must not be ignored.
+     * */
+    FDS_ECC_CLEAR();
+    memcpy(pData, pFlash, siz);
+    if (FDS_ECC_ERROR())
+    {
+        logErr("ECC error @ 0x%08lx\n", (uint32_t)pFlash);
+        return 0;
+    }
+#else
     memcpy(pData, pFlash, siz);
+#endif
+
+    FDS_CYCLES_ADD(ReadCycles, cycles);
 
     return siz;
 }
 
+const void* Fds::map(uint8_t uid, size_t *pSiz)
+{
+    fdsStatus_t retval = FDS_OK;
+    fdsDataHdr_t *pHdr = 0;
+    const void *pData = 0;
+    size_t siz = 0;
+
+    if (!InitDone)
+    {
+        retval = init();
+        if(retval != FDS_OK)
+        {
+            return 0;
+        }
+    }
+
+    if((uid >= FDS_NUM_RECORDS) || (pRecords[uid] == 0))
+    {
+        return 0;
+    }
+
+    do
+    {
+#if FDS_NUM_SLOTARRAYS > 0
+        int16_t idx = getSlotArray(uid);
+        if (idx >= 0)
+        {
+            pData = pRecords[uid];
+            siz = SlotCfg[idx].Siz;
+            break;
+        }
+#endif
+
+#if FDS_NUM_PINNED > 0
+        int16_t pin = getPinned(uid);
+        if (pin >= 0)
+        {
+            pData = pRecords[uid];
+            siz = PinCfg[pin].Siz;
+            break;
+        }
+#endif
+
+        /* Entries of a bundle are padded, all other records keep the last 
+         * byte of uneven data in the footer.
+         * */
+        pHdr = (fdsDataHdr_t*)pRecords[uid];
+        if ((pHdr->Magic != FDS_ENTRYMAGIC) && (pHdr->Siz % 2 != 0))
+        {
+            return 0;
+        }
+
+        pData = pHdr + 1;
+        siz = pHdr->Siz;
+
+    } while (0);
+
+    /* Records on pages written with a smaller FDS_PAYLOAD_ALIGN keep their
+     * old alignment until they are moved to a new page.
+     * */
+    if (((uintptr_t)pData & (FDS_PAYLOAD_ALIGN - 1)) != 0)
+    {
+        return 0;
+    }
+
+    if (pSiz != 0)
+    {
+        *pSiz = siz;
+    }
+
+    return pData;
+}
+
 fdsStatus_t Fds::del(uint8_t uid)
 {
     fdsStatus_t retval;
-    fdsDataHdr_t hdr;
-    fdsDataFtr_t ftr;
-    uint16_t *pStart = pWrite;
-    crc8 crc;
+    fdsBundleEntry_t entry;
+#if FDS_BYTEWRITE
+    uint16_t *pStart = 0;
+#endif
 
     if (!InitDone)
     {
@@ -344,38 +905,176 @@ fdsStatus_t Fds::del(uint8_t uid)
         return FDS_EEINVAL;
     }
 
-    hdr.Magic = FDS_DELMAGIC;
-    hdr.Uid = uid;
-    hdr.Siz = 0;
-    ftr.Data = 0;
-    crc.calc(&hdr, sizeof(hdr));
-    ftr.Crc = crc.calc(ftr.Data);
+    FDS_CYCLES_START(cycles);
 
-    do
+#if FDS_NUM_SLOTARRAYS > 0
+    int16_t idx = getSlotArray(uid);
+    if (idx >= 0)
     {
-        retval = writeToFlash(&hdr, sizeof(hdr), false);
-        breakIfDiverse(retval, FDS_OK);
+        retval = writeSlot(idx, FDS_DELMAGIC, 0);
+        FDS_CYCLES_ADD(WriteCycles, cycles);
+        return retval;
+    }
+#endif
 
-        retval = writeToFlash(&ftr, sizeof(ftr), false);
-        breakIfDiverse(retval, FDS_OK);
+#if FDS_NUM_PINNED > 0
+    int16_t pin = getPinned(uid);
+    if (pin >= 0)
+    {
+        retval = writePinned(pin, FDS_DELMAGIC, 0);
+        FDS_CYCLES_ADD(WriteCycles, cycles);
+        return retval;
+    }
+#endif
 
-    } while (0);
+    entry.Uid = uid;
+    entry.pData = 0;
+    entry.Siz = 0;
+    retval = prepareWrite(&entry, 1, 0);
+    if(retval != FDS_OK)
+    {
+        return retval;
+    }
 
+#if FDS_BYTEWRITE
+    pStart = pWrite;
+#endif
+    retval = writeRecord(FDS_DELMAGIC, uid, 0, 0);
     if (retval != FDS_OK)
     {
-        logErr("Error %u while writing to the flash\n", retval);
         return retval;
     }
 
-    crc = 0;
-    if (crc.calc(pStart, sizeof(hdr) + sizeof(ftr)) != 0)
+#if FDS_BYTEWRITE
+    retval = commitHome(uid, pStart);
+    if (retval != FDS_OK)
     {
-        return FDS_ECRC;
+        return retval;
     }
+#endif
 
     pRecords[uid] = 0;
 
-    return FDS_OK;
+#if FDS_STATS
+    Stats.Writes++;
+    FDS_CYCLES_ADD(WriteCycles, cycles);
+#endif
+
+    return commitWrite();
+}
+
+fdsStatus_t Fds::writeBundle(fdsBundleEntry_t *pEntries, uint8_t num)
+{
+    fdsStatus_t retval = FDS_OK;
+    size_t siz = 0;
+
+    if (!InitDone)
+    {
+        retval = init();
+        if(retval != FDS_OK)
+        {
+            return retval;
+        }
+    }
+
+    if ((pEntries == 0) || (num == 0) || (num > FDS_NUM_RECORDS))
+    {
+        return FDS_EEINVAL;
+    }
+
+    for (uint8_t n = 0; n < num; n++)
+    {
+        if ((pEntries[n].Uid >= FDS_NUM_RECORDS) || (pEntries[n].pData == 0))
+        {
+            return FDS_EEINVAL;
+        }
+
+#if FDS_NUM_SLOTARRAYS > 0
+        if (getSlotArray(pEntries[n].Uid) >= 0)
+        {
+            return FDS_EEINVAL;
+        }
+#endif
+
+#if FDS_NUM_PINNED > 0
+        if (getPinned(pEntries[n].Uid) >= 0)
+        {
+            return FDS_EEINVAL;
+        }
+#endif
+
+        for (uint8_t i = 0; i < n; i++)
+        {
+            if (pEntries[i].Uid == pEntries[n].Uid)
+            {
+                return FDS_EEINVAL;
+            }
+        }
+
+        if (pEntries[n].Siz == 0)
+        {
+            return FDS_ESIZE;
+        }
+    }
+
+    siz = getBundleSize(pEntries, num);
+    if (siz > FDS_MAX_DATABYTES)
+    {
+        return FDS_ESIZE;
+    }
+
+#if FDS_BYTEWRITE
+    /* Each record has its own home location, so there is nothing to share
+     * but the durability barrier. */
+    beginBatch();
+    for (uint8_t n = 0; n < num; n++)
+    {
+        retval = write(pEntries[n].Uid, pEntries[n].pData, pEntries[n].Siz);
+        breakIfDiverse(retval, FDS_OK);
+    }
+
+    if ((endBatch() != FDS_OK) && (retval == FDS_OK))
+    {
+        retval = FDS_EFLASH;
+    }
+
+    return retval;
+#else
+    FDS_CYCLES_START(cycles);
+
+    retval = prepareWrite(pEntries, num, siz);
+    if(retval != FDS_OK)
+    {
+        return retval;
+    }
+
+    beginBurst();
+    retval = writeBundleRecord(pEntries, num);
+    if (endBurst() != FDS_OK)
+    {
+        retval = FDS_EFLASH;
+    }
+
+#if FDS_STATS
+    if (retval == FDS_OK)
+    {
+        for (uint8_t n = 0; n < num; n++)
+        {
+            Stats.Writes++;
+            Stats.UserBytes += pEntries[n].Siz;
+        }
+    }
+
+    FDS_CYCLES_ADD(WriteCycles, cycles);
+#endif
+
+    if (retval == FDS_OK)
+    {
+        retval = commitWrite();
+    }
+
+    return retval;
+#endif
 }
 
 fdsStatus_t Fds::format(void)
@@ -383,33 +1082,90 @@ fdsStatus_t Fds::format(void)
     fdsStatus_t retval = FDS_OK;
 
     InitDone = false;
-    
-    bspFlashUnlock();
 
-    for (uint16_t page = 0; page < FDS_NUM_PAGES; page++)
+#if FDS_NUM_PINNED > 0
+    for (uint16_t page = 0; page < FDS_NUM_PINNED * 2; page++)
     {
-        bspFlashErasePage(BSP_FLASH_PAGETOADDR(FDS_FIRSTFLASHPAGE + page));
+        retval = erasePage(FDS_FIRSTPINPAGE + page);
+        if(retval != FDS_OK)
+        {
+            return retval;
+        }
     }
+#endif
 
-    bspFlashLock();
-
-    retval = writePageHdr(0, 0);
+    retval = formatLog();
     if(retval != FDS_OK)
     {
         return retval;
     }
 
+#if FDS_NUM_SLOTARRAYS > 0
+    for (uint8_t idx = 0; idx < FDS_NUM_SLOTARRAYS; idx++)
+    {
+        retval = formatSlotArray(idx);
+        if(retval != FDS_OK)
+        {
+            return retval;
+        }
+    }
+#endif
+
     return init(false);
 }
 
+void Fds::beginBatch(void)
+{
+#if FDS_SYNC
+    BatchDepth++;
+#endif
+}
+
+fdsStatus_t Fds::endBatch(void)
+{
+#if FDS_SYNC
+    if (BatchDepth > 0)
+    {
+        BatchDepth--;
+    }
+
+    if ((BatchDepth == 0) && SyncPending)
+    {
+        return syncFlash();
+    }
+#endif
+
+    return FDS_OK;
+}
+
+size_t Fds::getRegion(void **ppStart)
+{
+    if (ppStart != 0)
+    {
+        *ppStart = BSP_FLASH_PAGETOADDR(FDS_FIRSTPINPAGE);
+    }
+
+    return FDS_NUM_ALLPAGES * FDS_PAGESIZE;
+}
+
 uint16_t Fds::getPageid(uint16_t page)
+{
+    return getFlashPageid(FDS_FIRSTFLASHPAGE + page);
+}
+
+uint8_t Fds::getPageMagic(uint16_t page)
+{
+    page += FDS_FIRSTFLASHPAGE;
+    return ((fdsPageHdr_t*)BSP_FLASH_PAGETOADDR(page))->Magic;
+}
+
+uint16_t Fds::getFlashPageid(uint16_t flashPage)
 {
     uint16_t pageId = 0xFFFF;
     fdsPageHdr_t *pHdr;
     crc8 crc;
 
-    page += FDS_FIRSTFLASHPAGE;
-    pHdr = (fdsPageHdr_t*)BSP_FLASH_PAGETOADDR(page);
+    pHdr = (fdsPageHdr_t*)BSP_FLASH_PAGETOADDR(flashPage);
 
     if(crc.calc(pHdr, sizeof(fdsPageHdr_t)) == 0)
     {
@@ -419,23 +1175,99 @@ uint16_t Fds::getPageid(uint16_t page)
     return pageId;
 }
 
+fdsStatus_t Fds::formatLog(void)
+{
+    fdsStatus_t retval = FDS_OK;
+
+#if FDS_BYTEWRITE
+    /* Nothing to erase, just invalidate all copies and reset the selectors. 
+     * The header is written at last, it marks the memory as formatted.
+     * */
+    uint16_t sel = 0;
+    fdsDataHdr_t hdr;
+
+    hdr.Raw = 0xFFFFFFFF;
+    for (uint8_t uid = 0; uid < FDS_NUM_RECORDS; uid++)
+    {
+        for (uint8_t n = 0; n < 2; n++)
+        {
+            retval = progFlash(getHomeAddr(uid, n), &hdr, sizeof(hdr), false);
+            if(retval != FDS_OK)
+            {
+                return retval;
+            }
+        }
+
+        retval = progFlash(getSelAddr(uid), &sel, sizeof(sel), false);
+        if(retval != FDS_OK)
+        {
+            return retval;
+        }
+    }
+#else
+    for (uint16_t page = 0; page < FDS_NUM_PAGES; page++)
+    {
+        retval = erasePage(FDS_FIRSTFLASHPAGE + page);
+        if(retval != FDS_OK)
+        {
+            return retval;
+        }
+    }
+#endif
+
+    return writePageHdr(0, 0);
+}
+
 fdsStatus_t Fds::writePageHdr(uint16_t page, uint16_t uid)
 {
     fdsStatus_t retval = FDS_OK;
-    fdsPageHdr_t pageHdr;
-    crc8 crc;
 
     page += FDS_FIRSTFLASHPAGE;
     pWrite = BSP_FLASH_PAGETOADDR(page);
     
+    retval = writeFlashPageHdr(page, uid);
+    if(retval != FDS_EFLASH)
+    {
+        pWrite += FDS_PAGEHDRSIZE/2;
+    }
+
+    return retval;
+}
+
+fdsStatus_t Fds::writeFlashPageHdr(uint16_t flashPage, uint16_t uid)
+{
+    fdsStatus_t retval = FDS_OK;
+    fdsPageHdr_t pageHdr;
+    crc8 crc;
+
     pageHdr.Magic = FDS_PAGEMAGIC;
     pageHdr.Id = uid;
     pageHdr.Crc = crc.calc(&pageHdr, sizeof(pageHdr) - 1);
 
-    retval = writeToFlash(&pageHdr, sizeof(pageHdr));
+#if FDS_INTEGRITY_ECC
+    uint16_t buf[FDS_PAGEHDRSIZE / 2];
+
+    /* The header is padded with zeros to a full word, so the first record 
+     * starts in a word of its own. 
+     * */
+    memset(buf, 0, sizeof(buf));
+    memcpy(buf, &pageHdr, sizeof(pageHdr));
+    retval = progFlash(BSP_FLASH_PAGETOADDR(flashPage), buf, sizeof(buf), 
+        false);
+
+    crc = 0;
+    if ((retval == FDS_OK) && (crc.calc(BSP_FLASH_PAGETOADDR(flashPage), 
+        sizeof(pageHdr)) != 0))
+    {
+        retval = FDS_ECRC;
+    }
+#else
+    retval = progFlash(BSP_FLASH_PAGETOADDR(flashPage), &pageHdr, 
+        sizeof(pageHdr), true);
+#endif
     if(retval != FDS_OK)
     {
-        logErr("Error %u while writing PageHdr %u\n", retval, page);
+        logErr("Error %u while writing PageHdr %u\n", retval, flashPage);
     }
 
     return retval;
@@ -447,61 +1279,67 @@ fdsStatus_t Fds::readPage(uint16_t page, bool updateWritePointer)
     uint8_t *pData = 0;
     fdsDataHdr_t *pHdr = 0;
     uint16_t siz = 0;
-    crc8 crc;
+    bool ecc = FDS_PAGEMAGIC_HASFMT(getPageMagic(page), FDS_PAGEFMT_ECC);
+    bool padded = FDS_PAGEMAGIC_HASFMT(getPageMagic(page), 
+        FDS_PAGEFMT_ALIGNMASK);
+    uint16_t word = FDS_PAGEMAGIC_WORD(getPageMagic(page));
+#if FDS_CRC_ASYNC
+    uint8_t *pPend = 0;
+    uint16_t pendSiz = 0;
+#endif
 
     page += FDS_FIRSTFLASHPAGE;
-    pData = (uint8_t*)BSP_FLASH_PAGETOADDR(page) + sizeof(fdsPageHdr_t);
+    pData = (uint8_t*)BSP_FLASH_PAGETOADDR(page) + 
+        FDS_ALIGNUP(sizeof(fdsPageHdr_t), word);
 
     logDebug("Reading page %d\n", page);
 
-    while (BSP_FLASH_ADDRTOPAGE(pData) == page)
+    /* The data header must fit into the rest of the page */
+    while (BSP_FLASH_ADDRTOPAGE(pData + sizeof(fdsDataHdr_t) - 1) == page)
     {
         pHdr = (fdsDataHdr_t*)pData;
-        siz = sizeof(fdsDataHdr_t) + pHdr->Siz + sizeof(fdsDataFtr_t);
 
-        if (siz % 2 != 0)
+        /* Skip the zero half words used to align the next record */
+        if (padded && (*(uint16_t*)pData == 0))
+        {
+            pData += 2;
+            continue;
+        }
+
+        siz = FDS_RECORDEND(pData, pHdr->Siz, word) - (uintptr_t)pData;
+
+#if FDS_CRC_ASYNC
+        /* The header above has been parsed while the CRC of the previous 
+         * record was calculated, now its result is needed to process the 
+         * records in order.
+         * */
+        if (pPend != 0)
         {
-            siz--;
+            retval = loadRecord(pPend, pendSiz, FDS_CRC_RESULT() == 0);
+            pPend = 0;
+            breakIfDiverse(retval, FDS_OK);
         }
+#endif
 
         if (pHdr->Uid < FDS_NUM_RECORDS)
         {
-            if (crc.calc(pData, siz) == 0)
+#if FDS_CRC_ASYNC
+            if (!ecc)
             {
-                if (pHdr->Magic == FDS_DATAMAGIC)
-                {
-                    logDebug("Uid %d Data @ 0x%08lx\n", pHdr->Uid, 
-                        (uint32_t)pData);
-                    pRecords[pHdr->Uid] = pData;
-                }
-                else if(pHdr->Magic == FDS_DELMAGIC)
-                {
-                    logDebug("Uid %d RM @ 0x%08lx\n", pHdr->Uid, 
-                        (uint32_t)pData);
-                    pRecords[pHdr->Uid] = 0;
-                }
-                else
-                {
-                    logErr("Invalid Header Magic @ 0x%08lx\n", 
-                        (uint32_t)pData);
-                }
+                FDS_CRC_START(pData, siz);
+                pPend = pData;
+                pendSiz = siz;
             }
             else
+#endif
             {
-                logDebug("Invalid crc @ 0x%08lx (%u, 0x%x)\n", 
-                    (uint32_t)pData, siz, (uint8_t)crc);
-                retval = FDS_ECRC;
-                break;
+                retval = loadRecord(pData, siz, checkRecord(pData, siz, ecc));
+                breakIfDiverse(retval, FDS_OK);
             }
         }
         else if (pHdr->Raw == 0xFFFFFFFF)
         {
             logDebug("EOP @ 0x%08lx.\n", (uint32_t)pData);
-            if(updateWritePointer)
-            {
-                pWrite = (uint16_t*)pData;
-                logDebug("pWrite updated\n");
-            }
             break;
         }
         else
@@ -513,14 +1351,74 @@ fdsStatus_t Fds::readPage(uint16_t page, bool updateWritePointer)
         
         pData += siz;
     }
+
+#if FDS_CRC_ASYNC
+    /* The last record of a full page is still pending */
+    if (pPend != 0)
+    {
+        retval = loadRecord(pPend, pendSiz, FDS_CRC_RESULT() == 0);
+    }
+#endif
+
+    /* If the page is full the write pointer is set to its last half word, so
+     * the next write will switch to the next page.
+     * */
+    if((retval == FDS_OK) && updateWritePointer)
+    {
+        if (BSP_FLASH_ADDRTOPAGE(pData) != page)
+        {
+            pData = (uint8_t*)BSP_FLASH_PAGETOADDR(page + 1) - 2;
+        }
+
+        pWrite = (uint16_t*)pData;
+        logDebug("pWrite updated\n");
+    }
     
     return retval;
 }
 
-fdsStatus_t Fds::switchPage(uint16_t dataId)
+fdsStatus_t Fds::loadRecord(void *pRecord, uint16_t siz, bool valid)
+{
+    fdsStatus_t retval = FDS_OK;
+    fdsDataHdr_t *pHdr = (fdsDataHdr_t*)pRecord;
+
+    if (!valid)
+    {
+        logDebug("Invalid record @ 0x%08lx (%u)\n", (uint32_t)pRecord, siz);
+        return FDS_ECRC;
+    }
+
+    if (pHdr->Magic == FDS_DATAMAGIC)
+    {
+        logDebug("Uid %d Data @ 0x%08lx\n", pHdr->Uid, (uint32_t)pRecord);
+        pRecords[pHdr->Uid] = pRecord;
+    }
+    else if(pHdr->Magic == FDS_DELMAGIC)
+    {
+        logDebug("Uid %d RM @ 0x%08lx\n", pHdr->Uid, (uint32_t)pRecord);
+        pRecords[pHdr->Uid] = 0;
+    }
+    else if(pHdr->Magic == FDS_BUNDLEMAGIC)
+    {
+        logDebug("Bundle @ 0x%08lx\n", (uint32_t)pRecord);
+        retval = readBundle(pHdr);
+    }
+    else
+    {
+        logErr("Invalid Header Magic @ 0x%08lx\n", (uint32_t)pRecord);
+    }
+
+    return retval;
+}
+
+fdsStatus_t Fds::switchPage(fdsBundleEntry_t *pSkip, uint8_t numSkip)
 {
     fdsStatus_t retval = FDS_OK;
     uint16_t page, pageId;
+    fdsBundleEntry_t entries[FDS_NUM_RECORDS];
+    fdsDataHdr_t *pHdr = 0;
+    uint8_t num = 0;
+    bool skip = false;
     
     /* Get the current page number */
     page = BSP_FLASH_ADDRTOPAGE(pWrite) - FDS_FIRSTFLASHPAGE;
@@ -551,26 +1449,66 @@ fdsStatus_t Fds::switchPage(uint16_t dataId)
         page = wrapInc(page, 1, FDS_NUM_PAGES);
 
         /* Relocate all known parameters in tis page to the new one it can be 
-         * erased without losing data.
+         * erased without losing data. Entries of bundles are collected and 
+         * repacked into a single new bundle, as some entries of the bundles 
+         * might have been replaced in the meantime. All of this is written in
+         * a single burst.
          * */
+        beginBurst();
         for (uint16_t n = 0; n < FDS_NUM_RECORDS; n++)
         {
-            if ((n == dataId) || (pRecords[n] == 0))
+            /* Records which are about to be replaced are dropped */
+            skip = pRecords[n] == 0;
+            for (uint8_t i = 0; (i < numSkip) && !skip; i++)
+            {
+                skip = pSkip[i].Uid == n;
+            }
+
+            if (skip)
             {
                 continue;
             }
 
-            if (page == BSP_FLASH_ADDRTOPAGE(pRecords[n]))
+            if (FDS_FIRSTFLASHPAGE + page == BSP_FLASH_ADDRTOPAGE(pRecords[n]))
             {
+                pHdr = (fdsDataHdr_t*)pRecords[n];
+                if (pHdr->Magic == FDS_ENTRYMAGIC)
+                {
+                    entries[num].Uid = n;
+                    entries[num].pData = pHdr + 1;
+                    entries[num].Siz = pHdr->Siz;
+                    num++;
+                    continue;
+                }
+
                 retval = relocate(n);
                 breakIfDiverse(retval, FDS_OK);
             }
         }
 
+        if (retval != FDS_OK)
+        {
+            endBurst();
+            break;
+        }
+
+        if (num > 0)
+        {
+            retval = writeBundleRecord(entries, num);
+        }
+
+        if (endBurst() != FDS_OK)
+        {
+            retval = FDS_EFLASH;
+        }
+        breakIfDiverse(retval, FDS_OK);
+
+        /* The relocated records must be durable before the page is erased */
+        retval = syncFlash();
+        breakIfDiverse(retval, FDS_OK);
+
         /* Free the next page */
-        bspFlashUnlock();
-        bspFlashErasePage(BSP_FLASH_PAGETOADDR(FDS_FIRSTFLASHPAGE + page));
-        bspFlashLock();
+        retval = erasePage(FDS_FIRSTFLASHPAGE + page);
         
     } while (0);
 
@@ -580,62 +1518,1276 @@ fdsStatus_t Fds::switchPage(uint16_t dataId)
 fdsStatus_t Fds::relocate(uint16_t uid)
 {
     fdsStatus_t retval = FDS_OK;
-    uint16_t siz = ((fdsDataHdr_t*)pRecords[uid])->Siz;
+    uint16_t *pStart = 0;
+    fdsDataHdr_t *pHdr = (fdsDataHdr_t*)pRecords[uid];
+    uint16_t page = BSP_FLASH_ADDRTOPAGE(pHdr) - FDS_FIRSTFLASHPAGE;
+
+    retval = alignWrite();
+    if (retval != FDS_OK)
+    {
+        return retval;
+    }
+
+    /* Records on pages using the current format are copied as they are, all
+     * others are converted to the current format. The layout of padded 
+     * records depends on their position, so they are always rewritten.
+     * */
+    pStart = pWrite;
+    if ((getPageMagic(page) == FDS_PAGEMAGIC) && (FDS_WORDSIZE == 2))
+    {
+        retval = writeToFlash(pHdr, FDS_RECORDSIZE(pHdr->Siz), FDS_USE_CRC);
+    }
+    else
+    {
+        retval = writeRecord(pHdr->Magic, uid, pHdr + 1, pHdr->Siz);
+    }
+
+    if(retval == FDS_OK)
+    {
+        pRecords[uid] = pStart;
+    }
+    
+    return retval;
+}
+
+fdsStatus_t Fds::prepareWrite(fdsBundleEntry_t *pEntries, uint8_t num, 
+    size_t numBytes)
+{
+    fdsStatus_t retval = FDS_OK;
 
-    siz = siz % 2 != 0 ? siz - 1 : siz;
-    siz += sizeof(fdsDataHdr_t) + sizeof(fdsDataFtr_t);
+#if FDS_BYTEWRITE
+    uint8_t uid = pEntries[0].Uid;
 
-    do
-    {   
-        retval = writeToFlash(pRecords[uid], siz);
+    (void)num;
+    (void)numBytes;
+
+    /* The record is written to the inactive copy in its home location. 
+     * Within a batch this copy is still the durable one if the selector of
+     * the previous write of this uid has not been synced yet.
+     * */
+    pWrite = getHomeAddr(uid, (*getSelAddr(uid) & 1) ^ 1);
+#if FDS_SYNC
+    if (SyncPending && (SyncUid == uid))
+    {
+        retval = syncFlash();
+    }
+#endif
+#else
+    uint16_t page = BSP_FLASH_ADDRTOPAGE(pWrite) - FDS_FIRSTFLASHPAGE;
+    uint8_t *pEnd = (uint8_t*)FDS_RECORDEND(
+        (uint8_t*)pWrite + FDS_PADDING(pWrite), numBytes, FDS_WORDSIZE);
+
+    /* If this does not fit in the current page proceed on the next page. This
+     * is also done if the current page uses another format, as such pages are 
+     * never written again.
+     * */
+    if ((BSP_FLASH_ADDRTOPAGE(pWrite) != BSP_FLASH_ADDRTOPAGE(pEnd)) 
+        || (getPageMagic(page) != FDS_PAGEMAGIC))
+    {
+        retval = switchPage(pEntries, num);
         if(retval != FDS_OK)
         {
-            break;
+            logErr("Error %u while switchPage\n", retval);
+            return retval;
         }
-        
-        pRecords[uid] = pWrite;
+    }
+
+    retval = alignWrite();
+#endif
 
-    } while (0);
-    
     return retval;
 }
 
+fdsStatus_t Fds::alignWrite(void)
+{
+    fdsStatus_t retval = FDS_OK;
+    uint16_t pad = 0;
 
-fdsStatus_t Fds::writeToFlash(void * pData, size_t siz, bool checkCrc)
+    /* Zero half words are skipped while reading a page */
+    for (uint16_t n = FDS_PADDING(pWrite); n > 0; n -= sizeof(pad))
+    {
+        retval = writeToFlash(&pad, sizeof(pad), false);
+        breakIfDiverse(retval, FDS_OK);
+    }
+
+    return retval;
+}
+
+fdsStatus_t Fds::writeFooter(fdsDataFtr_t *pFtr)
+{
+    fdsStatus_t retval = FDS_OK;
+    uint16_t pad = 0;
+    size_t num = FDS_ALIGNUP((uintptr_t)pWrite, FDS_WORDSIZE) - 
+        (uintptr_t)pWrite + FDS_WORDSIZE - sizeof(*pFtr);
+
+    /* The rest of the current word and the front of the next one are padded,
+     * so the commit marker in the footer is programmed at last and on its own.
+     * */
+    for (; num > 0; num -= sizeof(pad))
+    {
+        retval = writeToFlash(&pad, sizeof(pad), false);
+        breakIfDiverse(retval, FDS_OK);
+    }
+
+    if (retval == FDS_OK)
+    {
+        retval = writeToFlash(pFtr, sizeof(*pFtr), false);
+    }
+
+    return retval;
+}
+
+fdsStatus_t Fds::writeRecord(uint8_t magic, uint8_t uid, void* pData, 
+    size_t numBytes)
 {
     fdsStatus_t retval = FDS_OK;
-    bspStatus_t bspStatus;
     uint16_t *pStart = pWrite;
+    fdsDataHdr_t hdr;
+    fdsDataFtr_t ftr;
+    uint8_t pad[2];
     crc8 crc;
 
+    /* Prepare the data header. In the header the real number of user data bytes
+     * has to be used! The crc clauclation can also start right now as the 
+     * header is compleate.
+     * */
+    hdr.Magic = magic;
+    hdr.Uid = uid;
+    hdr.Siz = numBytes;
+    if (FDS_USE_CRC)
+    {
+        crc.calc(&hdr, sizeof(hdr));
+    }
+
+    /* There is a spare byte reserved in the footer. It shall be used for user 
+     * data if the users data size is uneven. In this case the nuber of user 
+     * data bytes has to be reduced by one. 
+     * */
+    if(numBytes%2 != 0)
+    {
+        numBytes--;
+        ftr.Data = ((uint8_t*)pData)[numBytes];
+    }
+    else
+    {
+        ftr.Data = 0;
+    }
+
+    logDebug("New data starts @ 0x%08lx\n", (uint32_t)pWrite);
+
     do
-    {   
-        bspFlashUnlock();
-        bspStatus = bspFlashProg(pWrite, (uint16_t*)pData, siz);
-        bspFlashLock();
+    {
+        retval = writeToFlash(&hdr, sizeof(hdr), false);
+        breakIfDiverse(retval, FDS_OK);
+    
+        if(numBytes > 0)
+        {
+            if (FDS_USE_CRC)
+            {
+                crc.calc(pData, numBytes);
+            }
 
-        if (bspStatus != BSP_OK)
+            retval = writeToFlash(pData, numBytes, false);
+            breakIfDiverse(retval, FDS_OK);
+        }
+
+        /* If the footer gets a word of its own the data is kept in one piece,
+         * so the last byte of uneven data is written in front of the padding.
+         * */
+        if ((FDS_WORDSIZE > 2) && (hdr.Siz % 2 != 0))
         {
-            logErr("Error %u while writing to flash @ 0x%08lx, %u\n",
-                bspStatus, (uint32_t)pWrite, siz);
-            retval = FDS_EFLASH;
-            break;    
+            pad[0] = ftr.Data;
+            pad[1] = 0;
+            retval = writeToFlash(pad, sizeof(pad), false);
+            breakIfDiverse(retval, FDS_OK);
         }
+        
+        /* The footer union takes care of correct byte postions. If a change is 
+         * needed read the doc of fdsDataFtr_t first.
+         * */
+        ftr.Crc = FDS_USE_CRC ? crc.calc(ftr.Data) : FDS_COMMITMAGIC;
+        retval = writeFooter(&ftr);
+        breakIfDiverse(retval, FDS_OK);
+    
+    } while (0);
 
-        pWrite += siz/2;
+    if (retval != FDS_OK)
+    {
+        logErr("Error %u while writing to the flash\n", retval);
+        return FDS_EFLASH;
+    }
 
-        if(checkCrc == false)
+    /* During a burst the data is verified when it gets programmed */
+    if ((pBurst == 0) && !checkRecord(pStart, 
+        FDS_RECORDEND(pStart, hdr.Siz, FDS_WORDSIZE) - (uintptr_t)pStart, 
+        !FDS_USE_CRC))
+    {
+        return FDS_ECRC;
+    }
+
+    return FDS_OK;
+}
+
+fdsStatus_t Fds::readBundle(void *pBundle)
+{
+    fdsDataHdr_t *pHdr = (fdsDataHdr_t*)pBundle;
+    uint8_t *pData = (uint8_t*)(pHdr + 1);
+    uint8_t *pEnd = pData + pHdr->Siz;
+
+    while (pData < pEnd)
+    {
+        /* Skip the zero half words used to align the next entry */
+        if (*(uint16_t*)pData == 0)
         {
-            break;
+            pData += 2;
+            continue;
         }
 
-        if (crc.calc(pStart, siz) != 0)
+        pHdr = (fdsDataHdr_t*)pData;
+        if ((pHdr->Magic != FDS_ENTRYMAGIC) || (pHdr->Uid >= FDS_NUM_RECORDS) ||
+            (pData + sizeof(fdsDataHdr_t) + pHdr->Siz > pEnd))
         {
-            retval = FDS_ECRC;
-            break;
+            logErr("Invalid bundle entry @ 0x%08lx\n", (uint32_t)pData);
+            return FDS_EDATA;
         }
 
-    } while (0);
-    
-    return retval;
-}
\ No newline at end of file
+        logDebug("Uid %d Entry @ 0x%08lx\n", pHdr->Uid, (uint32_t)pData);
+        pRecords[pHdr->Uid] = pData;
+        pData += sizeof(fdsDataHdr_t) + ((pHdr->Siz + 1) & ~1);
+    }
+
+    return FDS_OK;
+}
+
+size_t Fds::getBundleSize(fdsBundleEntry_t *pEntries, uint8_t num)
+{
+    size_t siz = 0;
+
+    /* The data of the bundle starts aligned, so the padding of the entries 
+     * can be calculated from their offset.
+     * */
+    for (uint8_t n = 0; n < num; n++)
+    {
+        siz += FDS_PADDING(siz);
+        siz += sizeof(fdsDataHdr_t) + ((pEntries[n].Siz + 1) & ~1);
+    }
+
+    return siz;
+}
+
+fdsStatus_t Fds::writeBundleRecord(fdsBundleEntry_t *pEntries, uint8_t num)
+{
+    fdsStatus_t retval = FDS_OK;
+    uint16_t *pStart = 0;
+    uint16_t *pEntry[FDS_NUM_RECORDS];
+    size_t numBytes = 0;
+    fdsDataHdr_t hdr;
+    fdsDataHdr_t entry;
+    fdsDataFtr_t ftr;
+    uint8_t pad[2];
+    crc8 crc;
+
+    retval = alignWrite();
+    if (retval != FDS_OK)
+    {
+        return retval;
+    }
+
+    pStart = pWrite;
+
+    /* A single entry is written as a normal data record */
+    if (num == 1)
+    {
+        retval = writeRecord(FDS_DATAMAGIC, pEntries[0].Uid, pEntries[0].pData,
+            pEntries[0].Siz);
+        if (retval == FDS_OK)
+        {
+            pRecords[pEntries[0].Uid] = pStart;
+        }
+
+        return retval;
+    }
+
+    hdr.Magic = FDS_BUNDLEMAGIC;
+    hdr.Uid = pEntries[0].Uid;
+    hdr.Siz = getBundleSize(pEntries, num);
+
+    logDebug("New bundle starts @ 0x%08lx\n", (uint32_t)pWrite);
+
+    do
+    {
+        if (FDS_USE_CRC)
+        {
+            crc.calc(&hdr, sizeof(hdr));
+        }
+
+        retval = writeToFlash(&hdr, sizeof(hdr), false);
+        breakIfDiverse(retval, FDS_OK);
+
+        /* Each entry has its own header, so it can be read like any other 
+         * record. Uneven entries are padded with a zero byte, zero half words
+         * in front of an entry align its data.
+         * */
+        for (uint8_t n = 0; n < num; n++)
+        {
+            pad[0] = 0;
+            pad[1] = 0;
+            for (uint16_t i = FDS_PADDING(pWrite); i > 0; i -= sizeof(pad))
+            {
+                if (FDS_USE_CRC)
+                {
+                    crc.calc(pad, sizeof(pad));
+                }
+
+                retval = writeToFlash(pad, sizeof(pad), false);
+                breakIfDiverse(retval, FDS_OK);
+            }
+            breakIfDiverse(retval, FDS_OK);
+
+            entry.Magic = FDS_ENTRYMAGIC;
+            entry.Uid = pEntries[n].Uid;
+            entry.Siz = pEntries[n].Siz;
+            numBytes = entry.Siz & ~1;
+            pEntry[n] = pWrite;
+
+            if (FDS_USE_CRC)
+            {
+                crc.calc(&entry, sizeof(entry));
+            }
+
+            retval = writeToFlash(&entry, sizeof(entry), false);
+            breakIfDiverse(retval, FDS_OK);
+
+            if (numBytes > 0)
+            {
+                if (FDS_USE_CRC)
+                {
+                    crc.calc(pEntries[n].pData, numBytes);
+                }
+
+                retval = writeToFlash(pEntries[n].pData, numBytes, false);
+                breakIfDiverse(retval, FDS_OK);
+            }
+
+            if (entry.Siz % 2 != 0)
+            {
+                pad[0] = ((uint8_t*)pEntries[n].pData)[numBytes];
+                pad[1] = 0;
+                if (FDS_USE_CRC)
+                {
+                    crc.calc(pad, sizeof(pad));
+                }
+
+                retval = writeToFlash(pad, sizeof(pad), false);
+                breakIfDiverse(retval, FDS_OK);
+            }
+        }
+        breakIfDiverse(retval, FDS_OK);
+
+        ftr.Data = 0;
+        ftr.Crc = FDS_USE_CRC ? crc.calc(ftr.Data) : FDS_COMMITMAGIC;
+        retval = writeFooter(&ftr);
+        breakIfDiverse(retval, FDS_OK);
+
+    } while (0);
+
+    if (retval != FDS_OK)
+    {
+        logErr("Error %u while writing to the flash\n", retval);
+        return FDS_EFLASH;
+    }
+
+    if ((pBurst == 0) && !checkRecord(pStart, 
+        FDS_RECORDEND(pStart, hdr.Siz, FDS_WORDSIZE) - (uintptr_t)pStart, 
+        !FDS_USE_CRC))
+    {
+        return FDS_ECRC;
+    }
+
+    for (uint8_t n = 0; n < num; n++)
+    {
+        pRecords[pEntries[n].Uid] = pEntry[n];
+    }
+
+    return FDS_OK;
+}
+
+bool Fds::checkRecord(void *pRecord, size_t siz, bool ecc)
+{
+    volatile uint16_t *pHalf = (volatile uint16_t*)pRecord;
+    fdsDataFtr_t ftr;
+    crc8 crc;
+
+    if (!ecc)
+    {
+        return crc.calc(pRecord, siz) == 0;
+    }
+
+    /* Reading the header and the footer lets the flash check their ECC. The
+     * commit marker is written at last, so it is missing after a torn write.
+     * */
+    FDS_ECC_CLEAR();
+    (void)pHalf[0];
+    (void)pHalf[1];
+    ftr.Raw = pHalf[siz / 2 - 1];
+
+    return (ftr.Crc == FDS_COMMITMAGIC) && !FDS_ECC_ERROR();
+}
+
+fdsStatus_t Fds::progSlot(uint8_t *pSlot, uint16_t siz, uint16_t numBytes, 
+    uint8_t magic, void* pData)
+{
+    fdsStatus_t retval = FDS_OK;
+    uint16_t tail[(FDS_SLOTALIGN + FDS_WORDSIZE) / 2];
+    uint8_t *pTail = (uint8_t*)tail;
+    uint16_t offs = siz - FDS_WORDSIZE;
+    fdsSlotFtr_t ftr;
+    crc8 crc;
+
+    memset(tail, 0xFF, sizeof(tail));
+
+    /* Whole words of the data are programmed directly, the rest is copied to 
+     * the tail of the slot. In case of a deleted record the data is left 
+     * erased.
+     * */
+    if (magic == FDS_DATAMAGIC)
+    {
+        offs = numBytes & ~1 & ~(FDS_WORDSIZE - 1);
+        memcpy(pTail, (uint8_t*)pData + offs, numBytes - offs);
+        if (numBytes % 2 != 0)
+        {
+            pTail[numBytes - offs] = 0;
+        }
+    }
+
+    do
+    {
+        if ((magic == FDS_DATAMAGIC) && (offs > 0))
+        {
+            retval = progFlash((uint16_t*)pSlot, pData, offs, false);
+            breakIfDiverse(retval, FDS_OK);
+        }
+
+        /* The CRC of the data is calculated on the flash content, this way it
+         * is read back before the slot gets valid.
+         * */
+        crc.calc(pSlot, offs);
+        crc.calc(pTail, siz - offs - sizeof(ftr));
+        ftr.Magic = magic;
+        ftr.Crc = crc.calc(ftr.Magic);
+        memcpy(pTail + siz - offs - sizeof(ftr), &ftr, sizeof(ftr));
+
+        retval = progFlash((uint16_t*)(pSlot + offs), tail, siz - offs, false);
+        breakIfDiverse(retval, FDS_OK);
+
+        crc = 0;
+        if (crc.calc(pSlot, siz) != 0)
+        {
+            retval = FDS_ECRC;
+        }
+
+    } while (0);
+
+    return retval;
+}
+
+fdsStatus_t Fds::writeToFlash(void * pData, size_t siz, bool checkCrc)
+{
+    fdsStatus_t retval = FDS_OK;
+
+#if FDS_BURST_SIZE > 0
+    uint8_t *pSrc = (uint8_t*)pData;
+    size_t num = 0;
+
+    /* During a burst the data is staged in RAM and programmed row by row. The
+     * flash content is compared to the buffer when it gets programmed, so 
+     * there is no need for a CRC check.
+     * */
+    if (pBurst != 0)
+    {
+        while (siz > 0)
+        {
+            num = FDS_BURST_SIZE - 
+                (((uintptr_t)pBurst + BurstLen) & (FDS_BURST_SIZE - 1));
+            num = min(num, siz);
+
+            memcpy((uint8_t*)BurstBuf + BurstLen, pSrc, num);
+            BurstLen += num;
+            pSrc += num;
+            siz -= num;
+            pWrite += num/2;
+
+            if ((((uintptr_t)pBurst + BurstLen) & (FDS_BURST_SIZE - 1)) == 0)
+            {
+                retval = flushBurst();
+                breakIfDiverse(retval, FDS_OK);
+            }
+        }
+
+        return retval;
+    }
+#endif
+
+#if FDS_INTEGRITY_ECC
+    uint8_t *pBytes = (uint8_t*)pData;
+    size_t offs = 0;
+    size_t cnt = 0;
+
+    /* Each word is programmed once as a whole, so the data is staged until 
+     * the word is complete. Records end on full words, see writeFooter(). 
+     * */
+    (void)checkCrc;
+    while (siz > 0)
+    {
+        offs = (uintptr_t)pWrite & (FDS_WORDSIZE - 1);
+        cnt = min(FDS_WORDSIZE - offs, siz);
+
+        memcpy((uint8_t*)WordBuf + offs, pBytes, cnt);
+        pBytes += cnt;
+        siz -= cnt;
+        pWrite += cnt/2;
+
+        if (offs + cnt == FDS_WORDSIZE)
+        {
+            retval = progFlash(pWrite - FDS_WORDSIZE/2, WordBuf, FDS_WORDSIZE,
+                false);
+            breakIfDiverse(retval, FDS_OK);
+        }
+    }
+#else
+    retval = progFlash(pWrite, pData, siz, checkCrc);
+    if (retval != FDS_EFLASH)
+    {
+        pWrite += siz/2;
+    }
+#endif
+    
+    return retval;
+}
+
+void Fds::beginBurst(void)
+{
+#if FDS_BURST_SIZE > 0
+    pBurst = pWrite;
+    BurstLen = 0;
+
+#if FDS_INTEGRITY_ECC
+    /* A partly staged word is continued in the burst */
+    BurstLen = (uintptr_t)pWrite & (FDS_WORDSIZE - 1);
+    pBurst -= BurstLen/2;
+    memcpy(BurstBuf, WordBuf, BurstLen);
+#endif
+#endif
+}
+
+fdsStatus_t Fds::endBurst(void)
+{
+    fdsStatus_t retval = FDS_OK;
+
+#if FDS_BURST_SIZE > 0
+    if (pBurst != 0)
+    {
+        retval = flushBurst();
+        pBurst = 0;
+    }
+#endif
+
+    return retval;
+}
+
+#if FDS_BURST_SIZE > 0
+fdsStatus_t Fds::flushBurst(void)
+{
+    fdsStatus_t retval = FDS_OK;
+    bspStatus_t bspStatus;
+
+    if (BurstLen == 0)
+    {
+        return FDS_OK;
+    }
+
+    /* Only complete and aligned rows can be programmed in a burst, the first 
+     * and the last part of the data fall back to normal programming.
+     * */
+    bspFlashUnlock();
+    if ((BurstLen == FDS_BURST_SIZE) && 
+        (((uintptr_t)pBurst & (FDS_BURST_SIZE - 1)) == 0))
+    {
+        bspStatus = FDS_FLASH_PROGBURST(pBurst, BurstBuf, BurstLen);
+    }
+    else
+    {
+        bspStatus = bspFlashProg(pBurst, BurstBuf, BurstLen);
+    }
+    bspFlashLock();
+
+#if FDS_STATS
+    Stats.FlashBytes += BurstLen;
+#endif
+
+    if (bspStatus != BSP_OK)
+    {
+        logErr("Error %u while writing to flash @ 0x%08lx, %u\n",
+            bspStatus, (uint32_t)pBurst, BurstLen);
+        retval = FDS_EFLASH;
+    }
+    else if (memcmp(pBurst, BurstBuf, BurstLen) != 0)
+    {
+        logErr("Verify error @ 0x%08lx\n", (uint32_t)pBurst);
+        retval = FDS_EFLASH;
+    }
+
+    pBurst += BurstLen/2;
+    BurstLen = 0;
+
+    return retval;
+}
+#endif
+
+fdsStatus_t Fds::syncFlash(bool onlyPending)
+{
+#if FDS_SYNC
+    if (onlyPending && !SyncPending)
+    {
+        return FDS_OK;
+    }
+
+    SyncPending = false;
+
+#if FDS_STATS
+    Stats.Syncs++;
+#endif
+
+    if (FDS_FLASH_SYNC() != BSP_OK)
+    {
+        logErr("Error while syncing the flash\n");
+        return FDS_EFLASH;
+    }
+#else
+    (void)onlyPending;
+#endif
+
+    return FDS_OK;
+}
+
+fdsStatus_t Fds::commitWrite(void)
+{
+#if FDS_SYNC
+    /* Within a batch the barrier is shared by all writes */
+    if (BatchDepth > 0)
+    {
+        SyncPending = true;
+        return FDS_OK;
+    }
+#endif
+
+    return syncFlash();
+}
+
+fdsStatus_t Fds::erasePage(uint16_t flashPage)
+{
+    /* Writes of a batch which are not durable yet might still depend on the
+     * data which is about to be erased.
+     * */
+    fdsStatus_t retval = syncFlash(true);
+    if (retval != FDS_OK)
+    {
+        return retval;
+    }
+
+    bspFlashUnlock();
+    bspFlashErasePage(BSP_FLASH_PAGETOADDR(flashPage));
+    bspFlashLock();
+
+#if FDS_STATS
+    Stats.Erases[flashPage - FDS_FIRSTPINPAGE]++;
+#endif
+
+    return FDS_OK;
+}
+
+fdsStatus_t Fds::progFlash(uint16_t *pDst, void * pData, size_t siz, 
+    bool checkCrc)
+{
+    fdsStatus_t retval = FDS_OK;
+    bspStatus_t bspStatus;
+    crc8 crc;
+
+    do
+    {   
+        bspFlashUnlock();
+        bspStatus = bspFlashProg(pDst, (uint16_t*)pData, siz);
+        bspFlashLock();
+
+#if FDS_STATS
+        Stats.FlashBytes += siz;
+#endif
+
+        if (bspStatus != BSP_OK)
+        {
+            logErr("Error %u while writing to flash @ 0x%08lx, %u\n",
+                bspStatus, (uint32_t)pDst, siz);
+            retval = FDS_EFLASH;
+            break;    
+        }
+
+        if(checkCrc == false)
+        {
+            break;
+        }
+
+        if (crc.calc(pDst, siz) != 0)
+        {
+            retval = FDS_ECRC;
+            break;
+        }
+
+    } while (0);
+    
+    return retval;
+}
+
+#if FDS_BYTEWRITE
+
+uint16_t* Fds::getSelAddr(uint8_t uid)
+{
+    return BSP_FLASH_PAGETOADDR(FDS_FIRSTFLASHPAGE) + 
+        sizeof(fdsPageHdr_t) / 2 + uid;
+}
+
+uint16_t* Fds::getHomeAddr(uint8_t uid, uint8_t sel)
+{
+    uint16_t *pFirst = getSelAddr(FDS_NUM_RECORDS);
+
+    pFirst += FDS_PADDING(pFirst) / 2;
+
+    return pFirst + ((uid * 2 + sel) * FDS_HOMESIZE) / 2;
+}
+
+fdsStatus_t Fds::readHomes(void)
+{
+    fdsDataHdr_t *pHdr = 0;
+    uint16_t siz = 0;
+    crc8 crc;
+
+    if (getPageid(0) == 0xFFFF)
+    {
+        return FDS_EDATA;
+    }
+
+    /* The home locations depend on the payload alignment */
+    if (FDS_PAGEMAGIC_ALIGN(getPageMagic(0)) != FDS_PAYLOAD_ALIGN)
+    {
+        logErr("Home locations use another alignment\n");
+        return FDS_EDATA;
+    }
+
+    for (uint8_t uid = 0; uid < FDS_NUM_RECORDS; uid++)
+    {
+        pHdr = (fdsDataHdr_t*)getHomeAddr(uid, *getSelAddr(uid) & 1);
+        if ((pHdr->Uid != uid) || (pHdr->Siz > FDS_MAX_DATABYTES))
+        {
+            continue;
+        }
+
+        siz = sizeof(fdsDataHdr_t) + (pHdr->Siz & ~1) + sizeof(fdsDataFtr_t);
+        crc = 0;
+        if (crc.calc(pHdr, siz) != 0)
+        {
+            logDebug("Invalid crc @ 0x%08lx\n", (uint32_t)pHdr);
+            continue;
+        }
+
+        if (pHdr->Magic == FDS_DATAMAGIC)
+        {
+            logDebug("Uid %d Data @ 0x%08lx\n", uid, (uint32_t)pHdr);
+            pRecords[uid] = pHdr;
+        }
+    }
+
+    pWrite = getHomeAddr(0, 0);
+
+    return FDS_OK;
+}
+
+fdsStatus_t Fds::commitHome(uint8_t uid, uint16_t *pRecord)
+{
+    fdsStatus_t retval = FDS_OK;
+    uint16_t sel = pRecord == getHomeAddr(uid, 1) ? 1 : 0;
+
+    /* The record must be durable before the selector points to it */
+    retval = syncFlash();
+    if (retval != FDS_OK)
+    {
+        return retval;
+    }
+
+    retval = progFlash(getSelAddr(uid), &sel, sizeof(sel), false);
+    if ((retval == FDS_OK) && (*getSelAddr(uid) != sel))
+    {
+        retval = FDS_EFLASH;
+    }
+
+#if FDS_SYNC
+    /* The barrier above leaves this selector as the only one not durable */
+    SyncUid = uid;
+#endif
+
+    return retval;
+}
+
+#endif /* FDS_BYTEWRITE */
+
+#if FDS_NUM_SLOTARRAYS > 0
+
+int16_t Fds::getSlotArray(uint8_t uid)
+{
+    for (uint8_t idx = 0; idx < FDS_NUM_SLOTARRAYS; idx++)
+    {
+        if (SlotCfg[idx].Uid == uid)
+        {
+            return idx;
+        }
+    }
+
+    return -1;
+}
+
+uint16_t Fds::getSlotAlign(uint8_t idx, uint16_t page)
+{
+    uint16_t flashPage = BSP_FLASH_ADDRTOPAGE(getSlotAddr(idx, page, 0));
+
+    return FDS_PAGEMAGIC_SLOTALIGN(
+        ((fdsPageHdr_t*)BSP_FLASH_PAGETOADDR(flashPage))->Magic);
+}
+
+uint8_t* Fds::getSlotAddr(uint8_t idx, uint16_t page, uint16_t slot)
+{
+    uint16_t flashPage = FDS_FIRSTSLOTPAGE + page;
+    uint16_t align = 0;
+
+    for (uint8_t n = 0; n < idx; n++)
+    {
+        flashPage += SlotCfg[n].NumPages;
+    }
+
+    /* The layout of the slots depends on the format used by the page */
+    align = FDS_PAGEMAGIC_SLOTALIGN(
+        ((fdsPageHdr_t*)BSP_FLASH_PAGETOADDR(flashPage))->Magic);
+
+    return (uint8_t*)BSP_FLASH_PAGETOADDR(flashPage) + FDS_SLOTOFFSET(align) +
+        slot * FDS_SLOTSIZE(SlotCfg[idx].Siz, align);
+}
+
+uint16_t Fds::countSlots(uint8_t idx, uint16_t page)
+{
+    uint16_t align = getSlotAlign(idx, page);
+    uint16_t siz = FDS_SLOTSIZE(SlotCfg[idx].Siz, align);
+    uint16_t lo = 0;
+    uint16_t hi = FDS_SLOTSPERPAGE(SlotCfg[idx].Siz, align);
+    uint16_t mid = 0;
+    uint16_t *pSlot = 0;
+    bool erased = true;
+
+    /* Slots are written in ascending order, so all used slots are in front of
+     * the erased ones. A slot counts as used as soon as a single half word of 
+     * it has been programmed, even if the write has been interrupted.
+     * */
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        pSlot = (uint16_t*)getSlotAddr(idx, page, mid);
+        erased = true;
+
+        for (uint16_t n = 0; n < siz / 2; n++)
+        {
+            if (pSlot[n] != 0xFFFF)
+            {
+                erased = false;
+                break;
+            }
+        }
+
+        if (erased)
+        {
+            hi = mid;
+        }
+        else
+        {
+            lo = mid + 1;
+        }
+    }
+
+    return lo;
+}
+
+fdsStatus_t Fds::readSlotArray(uint8_t idx)
+{
+    const fdsSlotCfg_t *pCfg = &SlotCfg[idx];
+    uint16_t siz = 0;
+    uint16_t flashPage = BSP_FLASH_ADDRTOPAGE(getSlotAddr(idx, 0, 0));
+    uint16_t page = 0xFFFF;
+    uint16_t pageId = 0;
+    uint16_t prevId = 0;
+    uint16_t slot = 0;
+    fdsSlotFtr_t *pFtr = 0;
+    uint8_t *pSlot = 0;
+    crc8 crc;
+
+    pRecords[pCfg->Uid] = 0;
+    pSlotWrite[idx] = 0;
+
+    /* The current page is the one which is not followed by its successor */
+    for (uint16_t n = 0; n < pCfg->NumPages; n++)
+    {
+        pageId = getFlashPageid(flashPage + n);
+        if (pageId == 0xFFFF)
+        {
+            continue;
+        }
+
+        if (getFlashPageid(flashPage + wrapInc(n, 1, pCfg->NumPages)) != 
+            wrapInc(pageId, 1, 0xFFFF))
+        {
+            page = n;
+            break;
+        }
+    }
+
+    if (page == 0xFFFF)
+    {
+        return FDS_EDATA;
+    }
+
+    /* Pages written with another payload alignment keep their layout until
+     * the slot array proceeds to the next page.
+     * */
+    SlotPage[idx] = page;
+    slot = countSlots(idx, page);
+    if (slot < FDS_SLOTSPERPAGE(pCfg->Siz, getSlotAlign(idx, page)))
+    {
+        pSlotWrite[idx] = getSlotAddr(idx, page, slot);
+    }
+
+    /* Search backwards for the most recent valid slot. If there is none on the
+     * current page, e.g. when it has just been started, the previous page 
+     * still holds it.
+     * */
+    for (uint8_t cnt = 0; cnt < 2; cnt++)
+    {
+        siz = FDS_SLOTSIZE(pCfg->Siz, getSlotAlign(idx, page));
+        while (slot > 0)
+        {
+            slot--;
+            pSlot = getSlotAddr(idx, page, slot);
+
+            /* An interrupted write leaves the footer erased, so the magic is 
+             * checked as well as the crc. */
+            pFtr = (fdsSlotFtr_t*)(pSlot + siz - sizeof(fdsSlotFtr_t));
+            crc = 0;
+            if ((crc.calc(pSlot, siz) != 0) || ((pFtr->Magic != FDS_DATAMAGIC) 
+                && (pFtr->Magic != FDS_DELMAGIC)))
+            {
+                logDebug("Invalid slot @ 0x%08lx\n", (uint32_t)pSlot);
+                continue;
+            }
+
+            if (pFtr->Magic == FDS_DATAMAGIC)
+            {
+                logDebug("Uid %d Slot @ 0x%08lx\n", pCfg->Uid, (uint32_t)pSlot);
+                pRecords[pCfg->Uid] = pSlot;
+            }
+
+            return FDS_OK;
+        }
+
+        page = wrapInc(page, pCfg->NumPages - 1, pCfg->NumPages);
+        prevId = getFlashPageid(flashPage + page);
+        if ((prevId == 0xFFFF) || (wrapInc(prevId, 1, 0xFFFF) != pageId))
+        {
+            break;
+        }
+
+        slot = countSlots(idx, page);
+    }
+
+    return FDS_OK;
+}
+
+fdsStatus_t Fds::formatSlotArray(uint8_t idx)
+{
+    fdsStatus_t retval = FDS_OK;
+    uint16_t flashPage = BSP_FLASH_ADDRTOPAGE(getSlotAddr(idx, 0, 0));
+
+    for (uint16_t n = 0; n < SlotCfg[idx].NumPages; n++)
+    {
+        retval = erasePage(flashPage + n);
+        if(retval != FDS_OK)
+        {
+            return retval;
+        }
+    }
+
+    return writeFlashPageHdr(flashPage, 0);
+}
+
+fdsStatus_t Fds::writeSlot(uint8_t idx, uint8_t magic, void* pData)
+{
+    fdsStatus_t retval = FDS_OK;
+    const fdsSlotCfg_t *pCfg = &SlotCfg[idx];
+    uint16_t siz = 0;
+    uint16_t align = 0;
+    uint16_t flashPage = 0;
+    uint16_t page = 0;
+    uint16_t pageId = 0;
+    uint16_t slot = 0;
+    uint8_t *pSlot = 0;
+
+    /* If the current page is full, erase the next one and continue there. The
+     * current page stays valid until the first slot on the new one is written.
+     * This is also done if the current page uses another format.
+     * */
+    flashPage = BSP_FLASH_ADDRTOPAGE(getSlotAddr(idx, SlotPage[idx], 0));
+    if ((pSlotWrite[idx] == 0) || 
+        (((fdsPageHdr_t*)BSP_FLASH_PAGETOADDR(flashPage))->Magic != 
+        FDS_PAGEMAGIC))
+    {
+        pageId = wrapInc(getFlashPageid(flashPage), 1, 0xFFFF);
+        page = wrapInc(SlotPage[idx], 1, pCfg->NumPages);
+        flashPage = BSP_FLASH_ADDRTOPAGE(getSlotAddr(idx, page, 0));
+
+        retval = erasePage(flashPage);
+        if (retval != FDS_OK)
+        {
+            return retval;
+        }
+
+        SlotPage[idx] = page;
+        retval = writeFlashPageHdr(flashPage, pageId);
+        if (retval != FDS_OK)
+        {
+            return retval;
+        }
+
+        pSlotWrite[idx] = getSlotAddr(idx, SlotPage[idx], 0);
+    }
+
+    pSlot = pSlotWrite[idx];
+    align = getSlotAlign(idx, SlotPage[idx]);
+    siz = FDS_SLOTSIZE(pCfg->Siz, align);
+    logDebug("New slot starts @ 0x%08lx\n", (uint32_t)pSlot);
+
+    retval = progSlot(pSlot, siz, pCfg->Siz, magic, pData);
+
+    /* The slot is used, no matter if the write was successful or not */
+    slot = (pSlot - getSlotAddr(idx, SlotPage[idx], 0)) / siz + 1;
+    if (slot < FDS_SLOTSPERPAGE(pCfg->Siz, align))
+    {
+        pSlotWrite[idx] = getSlotAddr(idx, SlotPage[idx], slot);
+    }
+    else
+    {
+        pSlotWrite[idx] = 0;
+    }
+
+    if (retval != FDS_OK)
+    {
+        logErr("Error %u while writing slot\n", retval);
+        return retval;
+    }
+
+    pRecords[pCfg->Uid] = magic == FDS_DATAMAGIC ? pSlot : 0;
+
+#if FDS_STATS
+    Stats.Writes++;
+    Stats.UserBytes += magic == FDS_DATAMAGIC ? pCfg->Siz : 0;
+#endif
+
+    return commitWrite();
+}
+
+#endif /* FDS_NUM_SLOTARRAYS > 0 */
+
+#if FDS_NUM_PINNED > 0
+
+int16_t Fds::getPinned(uint8_t uid)
+{
+    for (uint8_t idx = 0; idx < FDS_NUM_PINNED; idx++)
+    {
+        if (PinCfg[idx].Uid == uid)
+        {
+            return idx;
+        }
+    }
+
+    return -1;
+}
+
+uint8_t Fds::getPinnedMagic(uint8_t idx, uint8_t copy)
+{
+    uint8_t magic = ((fdsPageHdr_t*)BSP_FLASH_PAGETOADDR(
+        FDS_FIRSTPINPAGE + idx * 2 + copy))->Magic;
+
+    /* Erased pages will be written in the current format */
+    return FDS_PAGEMAGIC_ISKNOWN(magic) ? magic : FDS_PAGEMAGIC;
+}
+
+uint8_t* Fds::getPinnedAddr(uint8_t idx, uint8_t copy)
+{
+    /* The layout depends on the alignment and word size used by the page */
+    return (uint8_t*)BSP_FLASH_PAGETOADDR(FDS_FIRSTPINPAGE + idx * 2 + copy) +
+        FDS_SLOTOFFSET(FDS_PAGEMAGIC_SLOTALIGN(getPinnedMagic(idx, copy)));
+}
+
+uint16_t Fds::getPinnedSize(uint8_t idx, uint8_t copy)
+{
+    return FDS_SLOTSIZE(PinCfg[idx].Siz, 
+        FDS_PAGEMAGIC_WORD(getPinnedMagic(idx, copy)));
+}
+
+bool Fds::checkPinned(uint8_t idx, uint8_t copy)
+{
+    uint8_t *pData = getPinnedAddr(idx, copy);
+    uint16_t siz = getPinnedSize(idx, copy);
+    fdsSlotFtr_t *pFtr = (fdsSlotFtr_t*)(pData + siz - sizeof(fdsSlotFtr_t));
+    crc8 crc;
+
+    if (getFlashPageid(FDS_FIRSTPINPAGE + idx * 2 + copy) == 0xFFFF)
+    {
+        return false;
+    }
+
+    /* An interrupted write leaves the footer erased, so the magic is checked
+     * as well as the crc. */
+    return (crc.calc(pData, siz) == 0) && ((pFtr->Magic == FDS_DATAMAGIC) || 
+        (pFtr->Magic == FDS_DELMAGIC));
+}
+
+fdsStatus_t Fds::progPinned(uint8_t idx, uint8_t copy, uint16_t id, 
+    uint8_t magic, void* pData)
+{
+    fdsStatus_t retval = FDS_OK;
+    uint16_t flashPage = FDS_FIRSTPINPAGE + idx * 2 + copy;
+
+    /* The record is always written in the current layout, the address of the
+     * data is known once the page header has been written.
+     * */
+    do
+    {
+        retval = erasePage(flashPage);
+        breakIfDiverse(retval, FDS_OK);
+
+        retval = writeFlashPageHdr(flashPage, id);
+        breakIfDiverse(retval, FDS_OK);
+
+        retval = progSlot(getPinnedAddr(idx, copy), 
+            getPinnedSize(idx, copy), PinCfg[idx].Siz, magic, pData);
+        breakIfDiverse(retval, FDS_OK);
+
+        if (!checkPinned(idx, copy))
+        {
+            retval = FDS_ECRC;
+        }
+
+    } while (0);
+
+    if (retval != FDS_OK)
+    {
+        logErr("Error %u while writing pinned record %u\n", retval, idx);
+    }
+
+    return retval;
+}
+
+fdsStatus_t Fds::readPinned(uint8_t idx)
+{
+    fdsStatus_t retval = FDS_OK;
+    uint16_t flashPage = FDS_FIRSTPINPAGE + idx * 2;
+    bool valid = checkPinned(idx, 0);
+    uint8_t *pData = 0;
+    fdsSlotFtr_t *pFtr = 0;
+
+    pRecords[PinCfg[idx].Uid] = 0;
+
+    /* The backup copy is written first, so the primary copy is restored if it
+     * is invalid or differs from a valid backup copy.
+     * */
+    if (checkPinned(idx, 1) && (!valid || 
+        (getFlashPageid(flashPage) != getFlashPageid(flashPage + 1))))
+    {
+        logInfo("Restoring pinned record %u\n", idx);
+        pData = getPinnedAddr(idx, 1);
+        pFtr = (fdsSlotFtr_t*)(pData + getPinnedSize(idx, 1) - 
+            sizeof(fdsSlotFtr_t));
+        retval = progPinned(idx, 0, getFlashPageid(flashPage + 1), 
+            pFtr->Magic, pData);
+        if (retval != FDS_OK)
+        {
+            return retval;
+        }
+
+        valid = true;
+    }
+
+    if (!valid)
+    {
+        return FDS_OK;
+    }
+
+    /* Copies written with another alignment or word size keep their layout 
+     * until the record is written again.
+     * */
+    pData = getPinnedAddr(idx, 0);
+    pFtr = (fdsSlotFtr_t*)(pData + getPinnedSize(idx, 0) - 
+        sizeof(fdsSlotFtr_t));
+    if (pFtr->Magic == FDS_DATAMAGIC)
+    {
+        logDebug("Uid %d Pinned @ 0x%08lx\n", PinCfg[idx].Uid, 
+            (uint32_t)pData);
+        pRecords[PinCfg[idx].Uid] = pData;
+    }
+
+    return FDS_OK;
+}
+
+fdsStatus_t Fds::writePinned(uint8_t idx, uint8_t magic, void* pData)
+{
+    fdsStatus_t retval = FDS_OK;
+    uint16_t id = getFlashPageid(FDS_FIRSTPINPAGE + idx * 2);
+
+    id = id == 0xFFFF ? 0 : wrapInc(id, 1, 0xFFFF);
+
+    /* The backup copy must be durable before the primary copy is erased */
+    retval = progPinned(idx, 1, id, magic, pData);
+    if (retval == FDS_OK)
+    {
+        retval = syncFlash();
+    }
+
+    if (retval != FDS_OK)
+    {
+        return retval;
+    }
+
+    /* The primary copy is invalid until it has been written again, it will be
+     * restored from the backup copy by the next init() if this fails.
+     * */
+    retval = progPinned(idx, 0, id, magic, pData);
+    if (retval != FDS_OK)
+    {
+        pRecords[PinCfg[idx].Uid] = 0;
+        return retval;
+    }
+
+    pRecords[PinCfg[idx].Uid] = magic == FDS_DATAMAGIC ? 
+        getPinnedAddr(idx, 0) : 0;
+
+#if FDS_STATS
+    Stats.Writes++;
+    Stats.UserBytes += magic == FDS_DATAMAGIC ? PinCfg[idx].Siz : 0;
+#endif
+
+    return commitWrite();
+}
+
+#endif /* FDS_NUM_PINNED > 0 */
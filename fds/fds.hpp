@@ -27,6 +27,102 @@
 #include <bsp/bsp_flash.h>
 #include <stdint.h>
 
+#ifndef FDS_NUM_SLOTARRAYS
+#define FDS_NUM_SLOTARRAYS              0
+#endif
+
+#ifndef FDS_NUM_SLOTPAGES
+#define FDS_NUM_SLOTPAGES               0
+#endif
+
+#ifndef FDS_NUM_PINNED
+#define FDS_NUM_PINNED                  0
+#endif
+
+#ifndef FDS_BYTEWRITE
+#define FDS_BYTEWRITE                   0
+#endif
+
+#ifndef FDS_INTEGRITY_ECC
+#define FDS_INTEGRITY_ECC               0
+#endif
+
+#ifndef FDS_ECC_WORDSIZE
+#define FDS_ECC_WORDSIZE                8
+#endif
+
+#ifndef FDS_ECC_CLEAR
+#define FDS_ECC_CLEAR()
+#endif
+
+#ifndef FDS_ECC_ERROR
+#define FDS_ECC_ERROR()                 (false)
+#endif
+
+#ifndef FDS_PAYLOAD_ALIGN
+#define FDS_PAYLOAD_ALIGN               2
+#endif
+
+#if (FDS_PAYLOAD_ALIGN != 2) && (FDS_PAYLOAD_ALIGN != 4) &&                   \
+    (FDS_PAYLOAD_ALIGN != 8) && (FDS_PAYLOAD_ALIGN != 16)
+#error "FDS_PAYLOAD_ALIGN must be 2, 4, 8 or 16"
+#endif
+
+#ifndef FDS_STATS
+#define FDS_STATS                       0
+#endif
+
+#if FDS_STATS && defined(FDS_CYCLES)
+#define FDS_STATS_CYCLES                1
+#else
+#define FDS_STATS_CYCLES                0
+#endif
+
+#ifndef FDS_BURST_SIZE
+#define FDS_BURST_SIZE                  0
+#endif
+
+#ifndef FDS_FLASH_PROGBURST
+#define FDS_FLASH_PROGBURST(pDst, pSrc, siz)    bspFlashProg(pDst, pSrc, siz)
+#endif
+
+#ifdef FDS_CRC_START
+#define FDS_CRC_ASYNC                   1
+#else
+#define FDS_CRC_ASYNC                   0
+#endif
+
+#ifdef FDS_FLASH_SYNC
+#define FDS_SYNC                        1
+#else
+#define FDS_SYNC                        0
+#endif
+
+#if (FDS_BURST_SIZE & (FDS_BURST_SIZE - 1)) != 0
+#error "FDS_BURST_SIZE must be a power of two"
+#endif
+
+#if (FDS_ECC_WORDSIZE < 4) || ((FDS_ECC_WORDSIZE & (FDS_ECC_WORDSIZE - 1)) != 0)
+#error "FDS_ECC_WORDSIZE must be a power of two of at least 4"
+#endif
+
+#if FDS_INTEGRITY_ECC && (FDS_BURST_SIZE > 0) &&                              \
+    (FDS_BURST_SIZE < FDS_ECC_WORDSIZE)
+#error "FDS_BURST_SIZE must not be smaller than FDS_ECC_WORDSIZE"
+#endif
+
+#if FDS_BYTEWRITE && (FDS_NUM_SLOTARRAYS > 0)
+#error "Slot arrays are not supported if FDS_BYTEWRITE is set"
+#endif
+
+#if FDS_BYTEWRITE && (FDS_NUM_PINNED > 0)
+#error "Pinned records are not supported if FDS_BYTEWRITE is set"
+#endif
+
+#if FDS_BYTEWRITE && FDS_INTEGRITY_ECC
+#error "FDS_INTEGRITY_ECC is not supported if FDS_BYTEWRITE is set"
+#endif
+
 /**
  * @brief Defnition of return codes used by libFds
  */
@@ -43,6 +139,51 @@ typedef enum
 
 }fdsStatus_t;
 
+/**
+ * @brief Defines a single entry of a bundle, see Fds::writeBundle().
+ */
+typedef struct
+{
+    uint8_t Uid;                    ///<! The uid of the entry.
+    void *pData;                    ///<! Pointer to the user's data.
+    size_t Siz;                     ///<! Size of the user's data in bytes.
+
+}fdsBundleEntry_t;
+
+#if FDS_STATS
+
+/**
+ * @brief Defines the statistics collected if FDS_STATS is set. They are kept 
+ * in RAM only and start at zero on each power up. The counters which grow 
+ * with each operation are 64 bit wide, so they do not wrap in long running
+ * simulations.
+ */
+typedef struct
+{
+    uint64_t Writes;                ///<! Number of records written or deleted.
+    uint64_t UserBytes;             ///<! User data bytes of these records.
+    uint64_t FlashBytes;            ///<! Bytes programmed to the flash.
+    uint64_t Reads;                 ///<! Number of records read.
+    uint32_t Mounts;                ///<! Number of times the flash was read.
+    uint64_t Syncs;                 ///<! Number of FDS_FLASH_SYNC() calls.
+
+#if FDS_STATS_CYCLES
+    uint64_t WriteCycles;           ///<! Cycles spent in write(), del() etc.
+    uint64_t ReadCycles;            ///<! Cycles spent in read().
+    uint64_t MountCycles;           ///<! Cycles spent reading the flash.
+#endif
+
+    /**
+     * @brief Number of erases per page, starting with the pages of the pinned
+     * records followed by the slot pages and the FDS_NUM_PAGES pages used for 
+     * all other records.
+     */
+    uint32_t Erases[FDS_NUM_PINNED * 2 + FDS_NUM_SLOTPAGES + FDS_NUM_PAGES];
+
+}fdsStats_t;
+
+#endif /* FDS_STATS */
+
 /**
  * @brief A class used to manage the a fraction of the on chip flash as data 
  * storage. It shall not be as mighty as a full blown file system as there are 
@@ -70,19 +211,30 @@ class Fds
          * @brief Intializes the library.
          * 
          * Has to be called once before it can be used. It reads the flash and 
-         * tries to format the falsh once in case of any error.
+         * tries to format the falsh once in case of any error. Only the 
+         * region with the error is formatted: the log pages or the pages of 
+         * a single slot array. Pinned records are never erased by init().
+         * Once the flash has been read further calls do nothing, unless force
+         * is set.
          * 
          * @param doReset Default is true, set this to false If you do not 
          *        want this function to format the falsh in case of a error.
          * 
+         * @param force Default is false, set this to true to read the flash 
+         *        again, e.g. after its content has been replaced by a image 
+         *        which has been saved before, see getRegion().
+         * 
          * @return FDS_OK       In case of sucess, also when a error has been 
          *                      solved by formatting the flash. 
+         *         FDS_EEINVAL  In case of a invalid slot array or pinned record
+         *                      configuration or if the records do not fit in 
+         *                      case of FDS_BYTEWRITE.
          *         FDS_ERR      In case of invalid page numbering.
          *         FDS_EFLASH   In case of a flash related error.
          *         FDS_ECRC     in case of a invalid CRC.
          *         FDS_EDATA    in case of invalid data id's in the falsh.
          */
-        fdsStatus_t init(bool doReset = true);
+        fdsStatus_t init(bool doReset = true, bool force = false);
 
         /**
          * @brief Used to print some status infos.
@@ -94,6 +246,28 @@ class Fds
          */
         fdsStatus_t info(void);
 
+#if FDS_STATS
+
+        /**
+         * @brief Used to get the statistics collected since power up or the 
+         *        last call of resetStats(). 
+         * 
+         * FlashBytes / UserBytes is the write amplification including all
+         * headers and relocated records. Together with the erase counts of 
+         * the pages it allows to extrapolate the lifetime of the flash from a 
+         * shorter run of the real workload.
+         * 
+         * @return Pointer to the statistics.
+         */
+        const fdsStats_t* getStats(void);
+
+        /**
+         * @brief Used to reset all statistics to zero.
+         */
+        void resetStats(void);
+
+#endif /* FDS_STATS */
+
         /**
          * @brief Used to write data to the flash
          * 
@@ -104,6 +278,10 @@ class Fds
          * 
          * @param siz Size of the user's data in bytes. 
          * 
+         * In case of a uid stored in a slot array numBytes must be equal to 
+         * the size given in FDS_SLOTARRAYS, in case of a pinned record to the 
+         * size given in FDS_PINNED.
+         * 
          * @return FDS_OK       in case of success.
          *         FDS_ESIZE    If the numBytes is of bytes is out of range
          *         FDS_EINVAL   If the uid is out of range.
@@ -125,10 +303,35 @@ class Fds
          * @return      Number of bytes read from the Flash.
          *              Might be zero if the requested UID is not present in 
          *              the flash yet. Will also be zero in case of any other
-         *              error.
+         *              error, like a ECC error if FDS_INTEGRITY_ECC is set.
          */
         size_t read(uint8_t uid, void* pData, size_t siz);
 
+        /**
+         * @brief Used to access the data of a record directly in the flash.
+         * 
+         * The data is aligned to FDS_PAYLOAD_ALIGN, so it can be accessed as a 
+         * struct without copying it. The pointer is only valid until the next
+         * call of write(), del(), writeBundle() or format(), as records might 
+         * be moved by any of them. Pinned records are the exception, their 
+         * data always stays at the same address. If FDS_INTEGRITY_ECC is set 
+         * ECC errors are not reported by this kind of access.
+         * 
+         * @param uid   The UID of the record.
+         *              Must be in the range of 0 - (FDS_NUM_RECORDS-1)
+         * @param pSiz  Optional pointer to store the size of the data.
+         * @return      Pointer to the data in the flash. Zero if the UID is 
+         *              not present in the flash yet or in case of a error. 
+         *              Also zero for records of uneven size which are not 
+         *              part of a bundle or slot array, as the last byte of 
+         *              them is stored in the footer of the record. And zero
+         *              for records which are not aligned to 
+         *              FDS_PAYLOAD_ALIGN, because they are still located on 
+         *              a page written with a smaller alignment. Use read() 
+         *              for them, they get aligned when their page is moved.
+         */
+        const void* map(uint8_t uid, size_t *pSiz);
+
         /**
          * @brief Used to delete a record from the falsh.
          * 
@@ -149,6 +352,35 @@ class Fds
          *         FDS_EDATA    in case of invalid data id's in the falsh.
          */
         fdsStatus_t del(uint8_t uid);
+
+        /**
+         * @brief Used to write several records at once.
+         * 
+         * All entries are stored in a single bundle record which has only one
+         * header and one CRC, this saves flash and time compared to calling 
+         * write() for each entry. Each entry is read with read() as usual. 
+         * 
+         * If FDS_BYTEWRITE is set there are no bundle records, each entry is 
+         * written by write() on its own. So if this fails the entries in 
+         * front of the failing one are already updated.
+         * 
+         * @param pEntries The entries to write, each uid may only be used once.
+         *        Uids stored in slot arrays and pinned records are not 
+         *        allowed.
+         * @param num The number of entries.
+         * 
+         * @return FDS_OK       in case of success.
+         *         FDS_ESIZE    If the size of a entry is zero or if all 
+         *                      entries including a 4 byte header per entry 
+         *                      and the alignment padding exceed 
+         *                      FDS_MAX_DATABYTES.
+         *         FDS_EEINVAL  In case of a invalid entry.
+         *         FDS_ERR      In case of invalid page numbering.
+         *         FDS_EFLASH   In case of a flash related error.
+         *         FDS_ECRC     in case of a invalid CRC.
+         *         FDS_EDATA    in case of invalid data id's in the falsh.
+         */
+        fdsStatus_t writeBundle(fdsBundleEntry_t *pEntries, uint8_t num);
         
         /**
          * @brief Use to reset the flash to a known state.
@@ -159,6 +391,45 @@ class Fds
          */
         fdsStatus_t format(void);
 
+        /**
+         * @brief Used to start a batch of writes sharing a single durability 
+         *        barrier, see FDS_FLASH_SYNC(). 
+         * 
+         * This is a plain manual batch, there is no time window and no 
+         * background flush. Each write(), del() and writeBundle() within the 
+         * batch returns once the data is programmed, but it is not durable 
+         * and may be lost on power loss until endBatch() has returned. Only 
+         * erasing a page or overwriting a previous copy issues the barrier 
+         * earlier. Batches may be nested, only the outermost endBatch() 
+         * syncs. Does nothing if FDS_FLASH_SYNC() is not defined.
+         */
+        void beginBatch(void);
+
+        /**
+         * @brief Used to end a batch of writes, see beginBatch(). All writes 
+         *        of the batch are durable once this returns FDS_OK.
+         * 
+         * @return FDS_OK       In case of success.
+         *         FDS_EFLASH   In case of a flash related error.
+         */
+        fdsStatus_t endBatch(void);
+
+        /**
+         * @brief Used to get the flash region used by libfds, including the 
+         *        pages of pinned records and slot arrays.
+         * 
+         * This can be used to save a image of the flash content and to load 
+         * it again, e.g. to run benchmarks on a aged flash, see FdsAging. 
+         * After loading a image init(true, true) has to be called before any
+         * other function, otherwise the records of the previous content are 
+         * used and later writes corrupt the image.
+         * 
+         * @param ppStart Used to return the start address of the region.
+         * 
+         * @return The size of the region in bytes.
+         */
+        size_t getRegion(void **ppStart);
+
     private:
 
         /**
@@ -219,6 +490,49 @@ class Fds
 
         }fdsDataFtr_t;
 
+        /**
+         * @brief Defines the configuration of a single slot array, see 
+         * FDS_SLOTARRAYS.
+         */
+        typedef struct
+        {
+            uint8_t Uid;            ///<! The uid stored in the slot array.
+            uint16_t Siz;           ///<! The size of the data in bytes.
+            uint16_t NumPages;      ///<! The number of flash pages used.
+
+        }fdsSlotCfg_t;
+
+        /**
+         * @brief Defines the footer of a single slot in a slot array.
+         * 
+         * A slot has no header as uid and size are known from the 
+         * configuration. It consists of the user data, padded with a zero byte
+         * if the size is uneven, and this footer. The magic is used to tell 
+         * data and deleted records apart and the CRC covers the whole slot. 
+         */
+        typedef union 
+        {
+            struct __attribute__((__packed__))
+            {
+                uint8_t Magic;      ///<! Data or delete magic.
+                uint8_t Crc;        ///<! The CRC of the slot.
+            };
+
+            uint16_t Raw;           ///<! uint16_t raw value for easy access.
+
+        }fdsSlotFtr_t;
+
+        /**
+         * @brief Defines the configuration of a single pinned record, see 
+         * FDS_PINNED.
+         */
+        typedef struct
+        {
+            uint8_t Uid;            ///<! The uid of the pinned record.
+            uint16_t Siz;           ///<! The size of the data in bytes.
+
+        }fdsPinCfg_t;
+
         /**
          * @brief Construct a new Fds object
          */
@@ -240,6 +554,36 @@ class Fds
          */
         uint16_t getPageid(uint16_t page);
 
+        /**
+         * @brief Same as getPageid() but for any flash page.
+         * 
+         * @param flashPage The absolute flash page number.
+         * 
+         * @return The page number stored in the page header of the given page.
+         *         0xFFFF       in case of a invalid page header crc. 
+         */
+        uint16_t getFlashPageid(uint16_t flashPage);
+
+        /**
+         * @brief Used to get the magic stored in the page header of the given
+         *        page. It defines the on flash format used by the page.
+         * 
+         * @param page the page number.
+         * 
+         * @return The magic of the page header.
+         */
+        uint8_t getPageMagic(uint16_t page);
+
+        /**
+         * @brief Used to format the log pages only, slot arrays and pinned 
+         *        records are not touched.
+         * 
+         * @return FDS_OK       In case of success.
+         *         FDS_EFLASH   In case of a flash related error.
+         *         FDS_ECRC     In case of a invalid CRC.
+         */
+        fdsStatus_t formatLog(void);
+
         /**
          * @brief Used to write the page header to the given page number.
          * 
@@ -254,6 +598,20 @@ class Fds
          */
         fdsStatus_t writePageHdr(uint16_t page, uint16_t uid);
 
+        /**
+         * @brief Same as writePageHdr() but for any flash page, the write 
+         *        pointer is not modified.
+         * 
+         * @param flashPage The absolute flash page number.
+         * 
+         * @param uid The page number to use.
+         * 
+         * @return FDS_OK       In case of success.
+         *         FDS_EFLASH   In case of a flash related error.
+         *         FDS_ECRC     In case of a invalid CRC.
+         */
+        fdsStatus_t writeFlashPageHdr(uint16_t flashPage, uint16_t uid);
+
         /**
          * @brief Used the read the provided page.
          * 
@@ -270,25 +628,63 @@ class Fds
          */
         fdsStatus_t readPage(uint16_t page, bool updateWritePointer);
 
+        /**
+         * @brief Used to write zero half words until the data of the next 
+         *        record is aligned to FDS_PAYLOAD_ALIGN.
+         * 
+         * @return FDS_OK       In case of success.
+         *         FDS_EFLASH   In case of a flash related error.
+         */
+        fdsStatus_t alignWrite(void);
+
+        /**
+         * @brief Used to write the footer of a record. If FDS_INTEGRITY_ECC is
+         *        set the record is padded with zero half words, so the footer 
+         *        ends a word of its own, see FDS_ECC_WORDSIZE.
+         * 
+         * @param pFtr The footer to write.
+         * 
+         * @return FDS_OK       In case of success.
+         *         FDS_EFLASH   In case of a flash related error.
+         */
+        fdsStatus_t writeFooter(fdsDataFtr_t *pFtr);
+
+        /**
+         * @brief Used to take over a record found while reading a page.
+         * 
+         * @param pRecord Pointer to the record in the flash.
+         * 
+         * @param siz The size of the record including header and footer.
+         * 
+         * @param valid The result of the integrity check of the record.
+         * 
+         * @return FDS_OK       In case of success.
+         *         FDS_ECRC     In case of a invalid record.
+         *         FDS_EDATA    In case of invalid data in the falsh.
+         */
+        fdsStatus_t loadRecord(void *pRecord, uint16_t siz, bool valid);
+
         /**
          * @brief Used to move the write pointer to FDS flash page (n+1)
          * 
          * This function will recycle the FDS falsh page (n+2) by moving it's 
          * data records to fds falsh page (n+1) and erasing it. The data records
-         * with the given id will be dropped. 
+         * of all uids which are about to be written will be dropped. 
          * 
-         * @param uid The uid to drop.
+         * @param pSkip The entries about to be written.
+         * @param numSkip The number of entries.
          * 
          * @return FDS_OK       In case of success.
          *         FDS_ERR      If flash page (n+1) is not free as expected.
          *         FDS_EFLASH   In case of a flash related error.
          *         FDS_ECRC     In case of a invalid CRC.         
          */
-        fdsStatus_t switchPage(uint16_t uid);
+        fdsStatus_t switchPage(fdsBundleEntry_t *pSkip, uint8_t numSkip);
 
         /**
          * @brief Used to rewrite the data record with the given id at the 
-         *        current write position.
+         *        current write position. Records on pages using an older
+         *        format are converted to the current format.
          * 
          * @param dataId The data record to rewrite.
          * 
@@ -297,6 +693,105 @@ class Fds
          */
         fdsStatus_t relocate(uint16_t dataId);
 
+        /**
+         * @brief Used to move the write pointer to the position where the next 
+         *        record shall be written. Switches to the next page if needed.
+         * 
+         * @param pEntries The entries of the record to write, a single one 
+         *                 unless a bundle is written.
+         * @param num The number of entries.
+         * @param numBytes The size of the data of the record in bytes.
+         * 
+         * @return FDS_OK       In case of success.
+         *         FDS_ERR      If flash page (n+1) is not free as expected.
+         *         FDS_EFLASH   In case of a flash related error.
+         *         FDS_ECRC     In case of a invalid CRC.         
+         */
+        fdsStatus_t prepareWrite(fdsBundleEntry_t *pEntries, uint8_t num, 
+            size_t numBytes);
+
+        /**
+         * @brief Used to write a data record at the current write position.
+         * 
+         * @param magic FDS_DATAMAGIC or FDS_DELMAGIC.
+         * @param uid The uid of the record.
+         * @param pData Pointer to the user's data.
+         * @param numBytes Size of the user's data in bytes.
+         * 
+         * @return FDS_OK       In case of success.
+         *         FDS_EFLASH   In case of a flash related error.
+         *         FDS_ECRC     In case of a invalid CRC.
+         */
+        fdsStatus_t writeRecord(uint8_t magic, uint8_t uid, void* pData, 
+            size_t numBytes);
+
+        /**
+         * @brief Used to program a slot of a slot array or a pinned record. 
+         *        Whole words of the data are programmed directly, the rest of
+         *        the slot is composed in RAM and programmed at last, so no 
+         *        word is programmed twice.
+         * 
+         * @param pSlot The address of the slot.
+         * @param siz The size of the slot in bytes.
+         * @param numBytes The size of the user's data in bytes.
+         * @param magic FDS_DATAMAGIC or FDS_DELMAGIC.
+         * @param pData The user data, not used in case of FDS_DELMAGIC.
+         * 
+         * @return FDS_OK       In case of success.
+         *         FDS_EFLASH   In case of a flash related error.
+         *         FDS_ECRC     In case of a invalid CRC.
+         */
+        fdsStatus_t progSlot(uint8_t *pSlot, uint16_t siz, uint16_t numBytes, 
+            uint8_t magic, void* pData);
+
+        /**
+         * @brief Used to read the entries of a bundle record while reading a
+         *        page.
+         * 
+         * @param pBundle The bundle record, its CRC must have been checked.
+         * 
+         * @return FDS_OK       In case of success.
+         *         FDS_EDATA    In case of a invalid entry.
+         */
+        fdsStatus_t readBundle(void *pBundle);
+
+        /**
+         * @brief Used to get the size of the data of a bundle record including
+         *        the headers and the alignment padding of all entries.
+         * 
+         * @param pEntries The entries of the bundle.
+         * @param num The number of entries.
+         * 
+         * @return The size in bytes.
+         */
+        size_t getBundleSize(fdsBundleEntry_t *pEntries, uint8_t num);
+
+        /**
+         * @brief Used to write a bundle record at the current write position.
+         *        A single entry is written as normal data record.
+         * 
+         * @param pEntries The entries to write.
+         * @param num The number of entries.
+         * 
+         * @return FDS_OK       In case of success.
+         *         FDS_EFLASH   In case of a flash related error.
+         *         FDS_ECRC     In case of a invalid CRC.
+         */
+        fdsStatus_t writeBundleRecord(fdsBundleEntry_t *pEntries, uint8_t num);
+
+        /**
+         * @brief Used to check if a record in the flash is valid.
+         * 
+         * @param pRecord The record.
+         * @param siz The size of the record in the flash in bytes.
+         * @param ecc Set if the record is on a page using FDS_PAGEFMT_ECC. 
+         *        Then the commit marker and the flash ECC flags are checked 
+         *        instead of the CRC.
+         * 
+         * @return true if the record is valid.
+         */
+        bool checkRecord(void *pRecord, size_t siz, bool ecc);
+
         /**
          * @brief Internal write function which takes care of moving the write
          *        poniter and checks crc is needed.
@@ -312,6 +807,324 @@ class Fds
          */
         fdsStatus_t writeToFlash(void * pData, size_t siz, bool checkCrc=true);
 
+        /**
+         * @brief Used to start a burst. Until endBurst() is called all data 
+         *        written by writeToFlash() is staged in RAM and programmed in
+         *        rows of FDS_BURST_SIZE bytes. Does nothing if FDS_BURST_SIZE 
+         *        is zero.
+         */
+        void beginBurst(void);
+
+        /**
+         * @brief Used to end a burst, programs all data which is still staged.
+         * 
+         * @return FDS_OK       In case of success.
+         *         FDS_EFLASH   In case of a flash related error.
+         */
+        fdsStatus_t endBurst(void);
+
+#if FDS_BURST_SIZE > 0
+
+        /**
+         * @brief Used to program the staged data of a burst. Complete and 
+         *        aligned rows are programmed by FDS_FLASH_PROGBURST(), all 
+         *        others by bspFlashProg(). The flash is compared to the 
+         *        staged data afterwards.
+         * 
+         * @return FDS_OK       In case of success.
+         *         FDS_EFLASH   In case of a flash related error.
+         */
+        fdsStatus_t flushBurst(void);
+
+#endif /* FDS_BURST_SIZE > 0 */
+
+        /**
+         * @brief Used to issue the durability barrier FDS_FLASH_SYNC() at 
+         *        once, also within a batch of writes.
+         * 
+         * @param onlyPending If set to true the barrier is only issued if a 
+         *        batch has deferred it.
+         * 
+         * @return FDS_OK       In case of success.
+         *         FDS_EFLASH   In case of a flash related error.
+         */
+        fdsStatus_t syncFlash(bool onlyPending = false);
+
+        /**
+         * @brief Used to make a completed write durable. Within a batch of 
+         *        writes the barrier is deferred to endBatch().
+         * 
+         * @return FDS_OK       In case of success.
+         *         FDS_EFLASH   In case of a flash related error.
+         */
+        fdsStatus_t commitWrite(void);
+
+        /**
+         * @brief Used to erase the given flash page. Deferred writes of a 
+         *        batch are synced before.
+         * 
+         * @param flashPage The absolute flash page number.
+         * 
+         * @return FDS_OK       In case of success.
+         *         FDS_EFLASH   In case of a flash related error.
+         */
+        fdsStatus_t erasePage(uint16_t flashPage);
+
+        /**
+         * @brief Used to program data to the given flash address. In contrast
+         *        to writeToFlash() the write pointer is not used.
+         * 
+         * @param pDst The flash address to write to.
+         * @param pData Data to write.
+         * @param siz Size of the data in bytes.
+         * @param checkCrc Defines if a CRC check shall be performed.
+         * 
+         * @return FDS_OK       In case of success.
+         *         FDS_EFLASH   In case of a flash related error.
+         *         FDS_ECRC     In case of a invalid CRC.
+         */
+        fdsStatus_t progFlash(uint16_t *pDst, void * pData, size_t siz, 
+            bool checkCrc);
+
+#if FDS_BYTEWRITE
+
+        /**
+         * @brief Used to get the address of the selector of the given uid. 
+         *        The selector defines which one of the two copies in the home
+         *        location is the valid one.
+         * 
+         * @param uid The uid.
+         * 
+         * @return The address of the selector.
+         */
+        uint16_t* getSelAddr(uint8_t uid);
+
+        /**
+         * @brief Used to get the address of a copy in the home location of the
+         *        given uid.
+         * 
+         * @param uid The uid.
+         * @param sel The copy, 0 or 1.
+         * 
+         * @return The address of the copy.
+         */
+        uint16_t* getHomeAddr(uint8_t uid, uint8_t sel);
+
+        /**
+         * @brief Used to read all home locations while initializing the 
+         *        library.
+         * 
+         * @return FDS_OK       In case of success.
+         *         FDS_EDATA    If the memory has not been formatted.
+         */
+        fdsStatus_t readHomes(void);
+
+        /**
+         * @brief Used to make the given copy the valid one by updating the 
+         *        selector. Only the low byte of the selector changes, so this 
+         *        is atomic on byte writable memory.
+         * 
+         * @param uid The uid.
+         * @param pRecord The address of the copy which has been written.
+         * 
+         * @return FDS_OK       In case of success.
+         *         FDS_EFLASH   In case of a memory related error.
+         */
+        fdsStatus_t commitHome(uint8_t uid, uint16_t *pRecord);
+
+#endif /* FDS_BYTEWRITE */
+
+#if FDS_NUM_SLOTARRAYS > 0
+
+        /**
+         * @brief Used to get the slot array used for the given uid.
+         * 
+         * @param uid The uid to look for.
+         * 
+         * @return The index of the slot array in FDS_SLOTARRAYS.
+         *         -1 if the uid is not stored in a slot array.
+         */
+        int16_t getSlotArray(uint8_t uid);
+
+        /**
+         * @brief Used to get the payload alignment used on a page of a slot 
+         *        array.
+         * 
+         * @param idx The index of the slot array.
+         * @param page The page number relative to the first page of the slot 
+         *        array.
+         * 
+         * @return The alignment in bytes.
+         */
+        uint16_t getSlotAlign(uint8_t idx, uint16_t page);
+
+        /**
+         * @brief Used to get the address of a slot.
+         * 
+         * @param idx The index of the slot array.
+         * @param page The page number relative to the first page of the slot 
+         *        array.
+         * @param slot The slot number on this page.
+         * 
+         * @return The address of the slot.
+         */
+        uint8_t* getSlotAddr(uint8_t idx, uint16_t page, uint16_t slot);
+
+        /**
+         * @brief Used to count the used slots on the given page. As slots are 
+         *        written in ascending order a binary search is used.
+         * 
+         * @param idx The index of the slot array.
+         * @param page The page number relative to the first page of the slot 
+         *        array.
+         * 
+         * @return The number of slots which are not erased.
+         */
+        uint16_t countSlots(uint8_t idx, uint16_t page);
+
+        /**
+         * @brief Used to read a slot array while initializing the library.
+         * 
+         * @param idx The index of the slot array.
+         * 
+         * @return FDS_OK       In case of success.
+         *         FDS_EDATA    If no valid page has been found.
+         */
+        fdsStatus_t readSlotArray(uint8_t idx);
+
+        /**
+         * @brief Used to erase the pages of a single slot array and to start 
+         *        it again on its first page.
+         * 
+         * @param idx The index of the slot array.
+         * 
+         * @return FDS_OK       In case of success.
+         *         FDS_EFLASH   In case of a flash related error.
+         *         FDS_ECRC     In case of a invalid CRC.
+         */
+        fdsStatus_t formatSlotArray(uint8_t idx);
+
+        /**
+         * @brief Used to write the next slot of a slot array. If the current 
+         *        page is full the next page of the slot array gets erased and 
+         *        used.
+         * 
+         * @param idx The index of the slot array.
+         * @param magic FDS_DATAMAGIC or FDS_DELMAGIC.
+         * @param pData The user data, not used in case of FDS_DELMAGIC.
+         * 
+         * @return FDS_OK       In case of success.
+         *         FDS_EFLASH   In case of a flash related error.
+         *         FDS_ECRC     In case of a invalid CRC.
+         */
+        fdsStatus_t writeSlot(uint8_t idx, uint8_t magic, void* pData);
+
+#endif /* FDS_NUM_SLOTARRAYS > 0 */
+
+#if FDS_NUM_PINNED > 0
+
+        /**
+         * @brief Used to get the index of the pinned record used for the given
+         *        uid.
+         * 
+         * @param uid The uid.
+         * 
+         * @return The index of the pinned record in FDS_PINNED.
+         *         -1 if the uid is not a pinned record.
+         */
+        int16_t getPinned(uint8_t uid);
+
+        /**
+         * @brief Used to get the page magic of a copy of a pinned record.
+         * 
+         * @param idx The index of the pinned record.
+         * @param copy The copy, see getPinnedAddr().
+         * 
+         * @return The page magic, FDS_PAGEMAGIC if the page is erased or uses
+         *         a unknown format.
+         */
+        uint8_t getPinnedMagic(uint8_t idx, uint8_t copy);
+
+        /**
+         * @brief Used to get the address of the data of a pinned record. It 
+         *        depends on the format of the page.
+         * 
+         * @param idx The index of the pinned record.
+         * @param copy 0 for the primary copy at the stable address, 1 for the
+         *        backup copy.
+         * 
+         * @return The address of the data.
+         */
+        uint8_t* getPinnedAddr(uint8_t idx, uint8_t copy);
+
+        /**
+         * @brief Used to get the size of the slot holding a copy of a pinned 
+         *        record, including padding and footer. It depends on the 
+         *        format of the page.
+         * 
+         * @param idx The index of the pinned record.
+         * @param copy The copy, see getPinnedAddr().
+         * 
+         * @return The size in bytes.
+         */
+        uint16_t getPinnedSize(uint8_t idx, uint8_t copy);
+
+        /**
+         * @brief Used to check if a copy of a pinned record is valid.
+         * 
+         * @param idx The index of the pinned record.
+         * @param copy The copy to check, see getPinnedAddr().
+         * 
+         * @return true if the page header, the magic and the CRC are valid.
+         */
+        bool checkPinned(uint8_t idx, uint8_t copy);
+
+        /**
+         * @brief Used to erase and program a copy of a pinned record.
+         * 
+         * @param idx The index of the pinned record.
+         * @param copy The copy to write, see getPinnedAddr().
+         * @param id The id stored in the page header, it tells which copy is 
+         *        the newer one.
+         * @param magic FDS_DATAMAGIC or FDS_DELMAGIC.
+         * @param pData The user data, not used in case of FDS_DELMAGIC.
+         * 
+         * @return FDS_OK       In case of success.
+         *         FDS_EFLASH   In case of a flash related error.
+         *         FDS_ECRC     In case of a invalid CRC.
+         */
+        fdsStatus_t progPinned(uint8_t idx, uint8_t copy, uint16_t id, 
+            uint8_t magic, void* pData);
+
+        /**
+         * @brief Used to read a pinned record while initializing the library.
+         *        The primary copy is restored from the backup copy if its 
+         *        update has been interrupted.
+         * 
+         * @param idx The index of the pinned record.
+         * 
+         * @return FDS_OK       In case of success.
+         *         FDS_EFLASH   In case of a flash related error.
+         *         FDS_ECRC     In case of a invalid CRC.
+         */
+        fdsStatus_t readPinned(uint8_t idx);
+
+        /**
+         * @brief Used to update a pinned record. The backup copy is written 
+         *        first, so one valid copy is left at any time.
+         * 
+         * @param idx The index of the pinned record.
+         * @param magic FDS_DATAMAGIC or FDS_DELMAGIC.
+         * @param pData The user data, not used in case of FDS_DELMAGIC.
+         * 
+         * @return FDS_OK       In case of success.
+         *         FDS_EFLASH   In case of a flash related error.
+         *         FDS_ECRC     In case of a invalid CRC.
+         */
+        fdsStatus_t writePinned(uint8_t idx, uint8_t magic, void* pData);
+
+#endif /* FDS_NUM_PINNED > 0 */
+
         /**
          * @brief Pomzer of the singelton instance.
          */
@@ -331,6 +1144,99 @@ class Fds
          * @brief The current write pointer in the flash.
          */
         uint16_t *pWrite;
+
+        /**
+         * @brief The flash address of the data staged for the current burst. 
+         * Zero if there is no burst.
+         */
+        uint16_t *pBurst;
+
+#if FDS_STATS
+
+        /**
+         * @brief The statistics, see getStats().
+         */
+        fdsStats_t Stats;
+
+#endif /* FDS_STATS */
+
+#if FDS_SYNC
+
+        /**
+         * @brief The nesting depth of beginBatch() calls.
+         */
+        uint8_t BatchDepth;
+
+        /**
+         * @brief True if a write of the current batch is not durable yet.
+         */
+        bool SyncPending;
+
+#if FDS_BYTEWRITE
+
+        /**
+         * @brief The uid of the selector which is not durable yet, only valid
+         *        if SyncPending is set.
+         */
+        uint8_t SyncUid;
+
+#endif
+
+#endif /* FDS_SYNC */
+
+#if FDS_INTEGRITY_ECC
+
+        /**
+         * @brief The buffer used to stage the current word until it is 
+         * complete, see writeToFlash().
+         */
+        uint16_t WordBuf[FDS_ECC_WORDSIZE / 2];
+
+#endif /* FDS_INTEGRITY_ECC */
+
+#if FDS_BURST_SIZE > 0
+
+        /**
+         * @brief The number of bytes staged for the current burst.
+         */
+        uint16_t BurstLen;
+
+        /**
+         * @brief The buffer used to stage the data of a burst.
+         */
+        uint16_t BurstBuf[FDS_BURST_SIZE / 2];
+
+#endif /* FDS_BURST_SIZE > 0 */
+
+#if FDS_NUM_SLOTARRAYS > 0
+
+        /**
+         * @brief The configuration of the slot arrays.
+         */
+        static const fdsSlotCfg_t SlotCfg[FDS_NUM_SLOTARRAYS];
+
+        /**
+         * @brief The current page of each slot array, relative to its first 
+         * page.
+         */
+        uint16_t SlotPage[FDS_NUM_SLOTARRAYS];
+
+        /**
+         * @brief The next free slot of each slot array. Zero if the current 
+         * page is full.
+         */
+        uint8_t *pSlotWrite[FDS_NUM_SLOTARRAYS];
+
+#endif /* FDS_NUM_SLOTARRAYS > 0 */
+
+#if FDS_NUM_PINNED > 0
+
+        /**
+         * @brief The configuration of the pinned records.
+         */
+        static const fdsPinCfg_t PinCfg[FDS_NUM_PINNED];
+
+#endif /* FDS_NUM_PINNED > 0 */
 };
 
 #endif /* FDS_HPP_  */
@@ -55,6 +55,179 @@ extern "C" {
  */
 #define FDS_MAX_DATABYTES               256
 
+/**
+ * @brief Defines the number of slot arrays. A slot array stores a single uid 
+ * with a constant size in its own flash region. This region is divided into 
+ * equal slots and each new version of the data is written to the next erased 
+ * slot. Hence that there is no data header and no page switch is needed, so 
+ * this is the cheapest way to store frequently updated data of fixed size.
+ * Set to zero to disable slot arrays.
+ */
+#define FDS_NUM_SLOTARRAYS              0
+
+/**
+ * @brief Defines the slot arrays as a list of {uid, size, pages}. The uid must 
+ * be in the range of 0 - (FDS_NUM_RECORDS-1), size is the fixed number of user 
+ * data bytes and pages the number of flash pages used by the slot array. At 
+ * least two pages are needed as one of them is erased when the other one is 
+ * full. 
+ * 
+ * Example: {{0, 8, 2}, {3, 32, 2}}
+ */
+#define FDS_SLOTARRAYS                  {}
+
+/**
+ * @brief Defines the total number of flash pages used by slot arrays. This 
+ * must be the sum of all pages given in FDS_SLOTARRAYS. These pages are placed
+ * right in front of the FDS_NUM_PAGES pages used for all other records.
+ */
+#define FDS_NUM_SLOTPAGES               0
+
+/**
+ * @brief Defines the number of pinned records. The data of a pinned record is 
+ * always found at the same flash address, so it can be used directly by a 
+ * bootloader or a DMA engine. Each pinned record uses two flash pages, a 
+ * primary copy at the stable address and a backup copy. Updates write the 
+ * backup copy first and the primary copy afterwards, if this is interrupted 
+ * the primary copy is restored by the next init(). Pinned records are never 
+ * relocated. Set to zero to disable pinned records.
+ */
+#define FDS_NUM_PINNED                  0
+
+/**
+ * @brief Defines the pinned records as a list of {uid, size}. The uid must be 
+ * in the range of 0 - (FDS_NUM_RECORDS-1) and size is the fixed number of user
+ * data bytes. The pages are placed right in front of the slot array pages, the
+ * primary copy of the n-th pinned record (counting from zero) is located on the
+ * flash page BSP_FLASH_NUMPAGES - FDS_NUM_PAGES - FDS_NUM_SLOTPAGES 
+ * - 2 * FDS_NUM_PINNED + 2 * n.
+ * 
+ * With W being FDS_ECC_WORDSIZE if FDS_INTEGRITY_ECC is set and 2 otherwise 
+ * and A being the larger one of FDS_PAYLOAD_ALIGN and W, the data starts 4 
+ * bytes rounded up to a multiple of A after the start of this page. So this is
+ * 4 bytes by default and 8 or 32 bytes with ECC on a STM32L4 or H7. The data 
+ * is followed by a zero byte if its size is uneven and by erased bytes up to 
+ * the footer. The footer {magic, crc} occupies the last two bytes of the 
+ * slot, which is size rounded up to an even number plus 2 and rounded up to 
+ * a multiple of W bytes long. It starts at the offset of the data plus this 
+ * slot size minus 2. The magic is 0x55 for valid data and the crc8 of 
+ * generic/crc8.hpp calculated over the whole slot is zero.
+ * A consumer which can not use Fds::map() shall check it the same way as 
+ * libfds does. Changing FDS_PAYLOAD_ALIGN or FDS_INTEGRITY_ECC moves the data 
+ * once the record has been written again.
+ * 
+ * Example: {{5, 16}, {6, 64}}
+ */
+#define FDS_PINNED                      {}
+
+/**
+ * @brief Set this to 1 if the memory used by libfds is byte writable and does 
+ * not need to be erased, like FRAM, MRAM or EEPROM. The memory must be memory 
+ * mapped and accessed by the bsp flash functions, FDS_NUM_PAGES defines its 
+ * size. Each record gets a fixed home location holding two copies of it, a 
+ * write updates the inactive copy and switches to it afterwards. So there is 
+ * no garbage collection at all. Slot arrays are not supported in this mode.
+ * 
+ * There is no separate access layer: read() and map() dereference the memory
+ * directly and all writes go through bspFlashProg(). So serial FRAM on SPI or
+ * I2C can not be used and the bsp flash functions of the board must target 
+ * this memory instead of the on chip flash.
+ */
+#define FDS_BYTEWRITE                   0
+
+/**
+ * @brief Set this to 1 on MCUs with ECC protected flash to skip the CRC of 
+ * data records. Records then end with a commit marker which reveals torn 
+ * writes, data integrity is checked by the flash ECC using the two macros 
+ * below. Records written before are still read and converted while pages are 
+ * switched. Slot arrays and page headers keep their CRC.
+ */
+#define FDS_INTEGRITY_ECC               0
+
+/**
+ * @brief Defines the size in bytes of the words the flash programs and 
+ * protects by ECC at once, e.g. 8 on a STM32L4/G4 and 32 on a STM32H7. A word
+ * must not be programmed twice, so if FDS_INTEGRITY_ECC is set page headers, 
+ * records and slots are padded to full words and the commit marker of a record
+ * gets a word of its own. Also used to read pages written with 
+ * FDS_INTEGRITY_ECC, so it must not be changed on a used flash.
+ */
+#define FDS_ECC_WORDSIZE                8
+
+/**
+ * @brief Used to clear the ECC error flags of the flash, e.g. FLASH->ECCR on 
+ * a STM32L4. Only needed if FDS_INTEGRITY_ECC is set.
+ */
+#define FDS_ECC_CLEAR()
+
+/**
+ * @brief Shall be true if the flash has reported a uncorrectable ECC error 
+ * since FDS_ECC_CLEAR(). Only needed if FDS_INTEGRITY_ECC is set.
+ */
+#define FDS_ECC_ERROR()                 (false)
+
+/**
+ * @brief Defines the alignment in bytes of the user data in the flash, one of
+ * 2, 4, 8 or 16. Records are padded as needed, so data containing uint32_t, 
+ * float or double values can be accessed in place by Fds::map() even on MCUs 
+ * without unaligned access. Pages written with another alignment are still 
+ * read and converted while pages are switched.
+ */
+#define FDS_PAYLOAD_ALIGN               2
+
+/**
+ * @brief Set this to 1 to collect statistics about the number of writes, the 
+ * programmed bytes and the erases of each page, see Fds::getStats(). This is 
+ * meant for endurance tests, e.g. to run the real workload on a host with a 
+ * simulated flash and extrapolate the time to the first worn out page.
+ */
+#define FDS_STATS                       0
+
+/**
+ * @brief Optional function returning a free running 32 bit cycle counter, e.g.
+ * DWT->CYCCNT on a Cortex-M3 and above or the instruction counter of a 
+ * emulator. If defined and FDS_STATS is set the cycles spent to write, read 
+ * and mount are summed up in the statistics. The counter must be enabled by 
+ * the application.
+ */
+// #define FDS_CYCLES()                    (DWT->CYCCNT)
+
+/**
+ * @brief Defines the size in bytes of the rows used for fast programming, e.g.
+ * 256 for the fast programming mode of a STM32L4/G4. While switching pages and
+ * while writing bundles the data is staged in a RAM buffer of this size and 
+ * each complete and aligned row is programmed by FDS_FLASH_PROGBURST(). Must 
+ * be a power of two, set to zero to disable it.
+ */
+#define FDS_BURST_SIZE                  0
+
+/**
+ * @brief The function used to program a complete row, it must return a 
+ * bspStatus_t like bspFlashProg() does.
+ */
+#define FDS_FLASH_PROGBURST(pDst, pSrc, siz)    bspFlashProg(pDst, pSrc, siz)
+
+/**
+ * @brief Optional hooks to calculate the record CRCs asynchronous while 
+ * mounting, e.g. by a CRC unit fed by DMA or by a worker thread on a host. 
+ * FDS_CRC_START() starts the calculation of the same crc8 as generic/crc8.hpp
+ * over siz bytes, FDS_CRC_RESULT() waits for it and returns the result. The 
+ * header of the next record is parsed in the meantime. Leave them undefined to
+ * calculate the CRC in software.
+ */
+// #define FDS_CRC_START(pData, siz)       crcUnitStart(pData, siz)
+// #define FDS_CRC_RESULT()                crcUnitResult()
+
+/**
+ * @brief Optional durability barrier, e.g. msync() or fdatasync() if the flash
+ * is emulated by a file on a host. It must return a bspStatus_t and is called 
+ * once a write has completed, once per batch of writes enclosed by 
+ * beginBatch() and endBatch() and wherever the order of programming and 
+ * erasing matters on power loss. Leave it undefined if programmed data is 
+ * durable at once like on a real flash.
+ */
+// #define FDS_FLASH_SYNC()                bspFlashSync()
+
 /**
  * @brief The log level to use in libfds. Currently there are no warnings, only
  * error, info and debug log messages.
@@ -0,0 +1,137 @@
+/*
+ * libfds, used to store data in the on chip flash of a MCU. It shall NOT be a 
+ * full blown file system but more than just a simple EEPROM emulation.
+ *
+ * Copyright (C) 2020 Julian Friedrich
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>. 
+ *
+ * You can file issues at https://github.com/fjulian79/libfds
+ */
+
+#include "tools/fds_aging.hpp"
+
+/**
+ * @brief Defines the size range of small records.
+ */
+#define FDS_AGING_SMALL                 ((FDS_MAX_DATABYTES + 7) / 8)
+
+/**
+ * @brief Defines the size range of medium records.
+ */
+#define FDS_AGING_MEDIUM                ((FDS_MAX_DATABYTES + 3) / 4)
+
+FdsAging::FdsAging(fdsAgingProfile_t profile, uint32_t seed, 
+    uint8_t firstUid, uint8_t numUids):
+     Profile(profile),
+     State(seed != 0 ? seed : 0x2545F491),
+     FirstUid(firstUid),
+     NumUids(numUids),
+     Ops(0)
+{
+
+}
+
+fdsStatus_t FdsAging::run(uint32_t numOps)
+{
+    fdsStatus_t retval = FDS_OK;
+    Fds *pFds = Fds::getInstance();
+    uint8_t uid = 0;
+    size_t siz = 0;
+    bool del = false;
+
+    if ((NumUids == 0) || (FirstUid + NumUids > FDS_NUM_RECORDS))
+    {
+        return FDS_EEINVAL;
+    }
+
+    for (uint32_t n = 0; n < numOps; n++)
+    {
+        uid = random(FirstUid, NumUids);
+        siz = random(1, FDS_AGING_MEDIUM);
+        del = false;
+
+        switch (Profile)
+        {
+            case FDS_AGING_HOTUIDS:
+                if (random(0, 10) != 0)
+                {
+                    uid = random(FirstUid, NumUids < 2 ? NumUids : 2);
+                }
+                siz = random(1, FDS_AGING_SMALL);
+                break;
+
+            case FDS_AGING_BLOB:
+                if (random(0, 8) == 0)
+                {
+                    uid = FirstUid;
+                    siz = FDS_MAX_DATABYTES;
+                }
+                else
+                {
+                    siz = random(1, FDS_AGING_SMALL);
+                }
+                break;
+
+            case FDS_AGING_DELHEAVY:
+                del = random(0, 10) < 4;
+                break;
+
+            default:
+                break;
+        }
+
+        if (del)
+        {
+            retval = pFds->del(uid);
+        }
+        else
+        {
+            for (size_t i = 0; i < siz; i++)
+            {
+                Buf[i] = (uint8_t)random();
+            }
+
+            retval = pFds->write(uid, Buf, siz);
+        }
+
+        if (retval != FDS_OK)
+        {
+            break;
+        }
+
+        Ops++;
+    }
+
+    return retval;
+}
+
+uint32_t FdsAging::getOps(void)
+{
+    return Ops;
+}
+
+uint32_t FdsAging::random(void)
+{
+    State ^= State << 13;
+    State ^= State >> 17;
+    State ^= State << 5;
+
+    return State;
+}
+
+uint32_t FdsAging::random(uint32_t first, uint32_t num)
+{
+    return first + random() % num;
+}
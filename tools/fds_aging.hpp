@@ -0,0 +1,147 @@
+/*
+ * libfds, used to store data in the on chip flash of a MCU. It shall NOT be a 
+ * full blown file system but more than just a simple EEPROM emulation.
+ *
+ * Copyright (C) 2020 Julian Friedrich
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>. 
+ *
+ * You can file issues at https://github.com/fjulian79/libfds
+ */
+
+#ifndef FDS_AGING_HPP_
+#define FDS_AGING_HPP_
+
+#include "fds/fds.hpp"
+#include <stdint.h>
+
+/**
+ * @brief Defines the workload profiles used to age the flash.
+ */
+typedef enum
+{
+    /*  0 */ FDS_AGING_UNIFORM = 0, ///<! All uids are written equally often.
+    /*  1 */ FDS_AGING_HOTUIDS,     ///<! 90% of all writes hit two hot uids.
+    /*  2 */ FDS_AGING_BLOB,        ///<! Small writes, every 8th one is a 
+                                    ///<! FDS_MAX_DATABYTES blob.
+    /*  3 */ FDS_AGING_DELHEAVY,    ///<! 40% of all operations are deletes.
+
+}fdsAgingProfile_t;
+
+/**
+ * @brief A class used to bring the flash used by libfds into the state of a 
+ * long running device. 
+ * 
+ * It drives the normal write() and del() functions with one of the workload 
+ * profiles above. Sizes, uids and data are taken from a pseudo random 
+ * generator, so the same profile, seed, number of operations and 
+ * configuration always result in the same flash content if the flash has been 
+ * formatted before. Fds::getRegion() gives access to the flash content, e.g. 
+ * to save it as a image and load it again before running benchmarks or mount
+ * tests. After loading a image Fds::init(true, true) has to be called to read
+ * the flash again.
+ * 
+ * This is a host tool, it is not part of the library sources.
+ */
+class FdsAging
+{
+    public:
+
+        /**
+         * @brief Construct a new FdsAging object.
+         * 
+         * @param profile The workload profile to use.
+         * 
+         * @param seed The seed of the pseudo random generator.
+         * 
+         * @param firstUid The first uid to use.
+         * 
+         * @param numUids The number of uids to use, starting at firstUid. Uids 
+         *        stored in slot arrays or pinned records must not be part of 
+         *        this range as their size is fixed.
+         */
+        FdsAging(fdsAgingProfile_t profile, uint32_t seed, 
+            uint8_t firstUid = 0, uint8_t numUids = FDS_NUM_RECORDS);
+
+        /**
+         * @brief Used to run the given number of operations.
+         * 
+         * Can be called several times, e.g. to save images after different 
+         * numbers of operations. 
+         * 
+         * @param numOps The number of write or delete operations to run.
+         * 
+         * @return FDS_OK       In case of success.
+         *         The error returned by Fds::write() or Fds::del() otherwise.
+         */
+        fdsStatus_t run(uint32_t numOps);
+
+        /**
+         * @brief Used to get the number of operations done so far.
+         * 
+         * @return The number of operations.
+         */
+        uint32_t getOps(void);
+
+    private:
+
+        /**
+         * @brief Used to get the next pseudo random number (xorshift32).
+         * 
+         * @return The number.
+         */
+        uint32_t random(void);
+
+        /**
+         * @brief Used to get a pseudo random number in the given range.
+         * 
+         * @param first The first number of the range.
+         * @param num The number of values in the range.
+         * 
+         * @return The number, in the range of first - (first + num - 1).
+         */
+        uint32_t random(uint32_t first, uint32_t num);
+
+        /**
+         * @brief The workload profile.
+         */
+        fdsAgingProfile_t Profile;
+
+        /**
+         * @brief The state of the pseudo random generator.
+         */
+        uint32_t State;
+
+        /**
+         * @brief The first uid to use.
+         */
+        uint8_t FirstUid;
+
+        /**
+         * @brief The number of uids to use.
+         */
+        uint8_t NumUids;
+
+        /**
+         * @brief The number of operations done so far.
+         */
+        uint32_t Ops;
+
+        /**
+         * @brief The buffer used for the data to write.
+         */
+        uint8_t Buf[FDS_MAX_DATABYTES];
+};
+
+#endif /* FDS_AGING_HPP_  */